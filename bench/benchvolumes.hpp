@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "voxel/box.hpp"
+
+// Synthetic volumes shared by the benchmarks
+
+inline unsigned int hashCell(int x, int y, int z)
+{
+    unsigned int h = x * 73856093u ^ y * 19349663u ^ z * 83492791u;
+    
+    h ^= h >> 13;
+    h *= 0x5bd1e995;
+    h ^= h >> 15;
+    
+    return h;
+}
+
+inline float valueNoise(float x, float y, float z)
+{
+    int ix = int(floorf(x)), iy = int(floorf(y)), iz = int(floorf(z));
+    float fx = x - ix, fy = y - iy, fz = z - iz;
+    
+    float result = 0;
+    
+    for (int dz = 0; dz < 2; ++dz)
+        for (int dy = 0; dy < 2; ++dy)
+            for (int dx = 0; dx < 2; ++dx)
+            {
+                float w = (dx ? fx : 1 - fx) * (dy ? fy : 1 - fy) * (dz ? fz : 1 - fz);
+                
+                result += w * (hashCell(ix + dx, iy + dy, iz + dz) & 0xffff) / 65535.f;
+            }
+    
+    return result;
+}
+
+inline void fillVolume(voxel::Box& box, const function<int(int, int, int)>& f)
+{
+    for (int z = 0; z < box.getDepth(); ++z)
+        for (int y = 0; y < box.getHeight(); ++y)
+            for (int x = 0; x < box.getWidth(); ++x)
+                box.set(x, y, z, voxel::Cell { static_cast<unsigned char>(glm::clamp(f(x, y, z), 0, 255)), 0 });
+}
+
+inline voxel::Box generateVolume(const string& name, unsigned int size)
+{
+    voxel::Box box(size, size, size);
+    
+    float half = size / 2.f;
+    
+    if (name == "flat")
+    {
+        fillVolume(box, [&](int x, int y, int z) { return int((half - z) * 255); });
+    }
+    else if (name == "hills")
+    {
+        // same shape as generateWorld, scaled to the box
+        float scale = size / 64.f;
+        
+        fillVolume(box, [&](int x, int y, int z) {
+            float hx = (x / scale - 32) / 8.f, hy = (y / scale - 32) / 8.f;
+            float hill = hx * hx + hy * hy;
+            
+            return (z < 5 * scale) ? 255 : (z > 10 * scale) ? 0 : int((1.f - glm::clamp(sqrtf(hill), 0.f, 1.f)) * 255);
+        });
+    }
+    else if (name == "caves")
+    {
+        fillVolume(box, [&](int x, int y, int z) {
+            float n = valueNoise(x / 8.f, y / 8.f, z / 8.f) * 0.7f + valueNoise(x / 3.f, y / 3.f, z / 3.f) * 0.3f;
+            
+            return int((n - 0.45f) * 10 * 255);
+        });
+    }
+    else if (name == "air")
+    {
+        fillVolume(box, [&](int x, int y, int z) { return 0; });
+    }
+    else if (name == "solid")
+    {
+        fillVolume(box, [&](int x, int y, int z) { return 255; });
+    }
+    else if (name == "checkerboard")
+    {
+        fillVolume(box, [&](int x, int y, int z) { return ((x ^ y ^ z) & 1) * 255; });
+    }
+    else
+    {
+        fprintf(stderr, "Unknown volume %s\n", name.c_str());
+        exit(1);
+    }
+    
+    return box;
+}
\ No newline at end of file
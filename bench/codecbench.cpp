@@ -0,0 +1,105 @@
+#include "common.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+
+#include "voxel/box.hpp"
+#include "voxel/chunkcodec.hpp"
+
+#include "benchvolumes.hpp"
+
+// Runs f until minTime elapses and returns seconds per call
+template <typename F> static double measure(double minTime, F f)
+{
+    typedef chrono::high_resolution_clock Clock;
+    
+    unsigned int iterations = 0;
+    
+    Clock::time_point start = Clock::now();
+    double elapsed = 0;
+    
+    do
+    {
+        f();
+        
+        iterations++;
+        elapsed = chrono::duration<double>(Clock::now() - start).count();
+    }
+    while (elapsed < minTime);
+    
+    return elapsed / iterations;
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int size = argc > 1 ? atoi(argv[1]) : 64;
+    double minTime = argc > 2 ? atof(argv[2]) : 0.5;
+    
+    const char* volumes[] = { "flat", "hills", "caves", "air", "solid", "checkerboard" };
+    
+    for (auto& volume: volumes)
+    {
+        voxel::Box box = generateVolume(volume, size);
+        
+        size_t count = size_t(size) * size * size;
+        size_t bytes = count * sizeof(voxel::Cell);
+        
+        const unsigned char* occupancy = box.getOccupancy().getData();
+        const unsigned char* material = box.getMaterial().getData();
+        
+        vector<unsigned char> copy(count * 2);
+        vector<unsigned char> encoded;
+        
+        voxel::encodePlanes(encoded, occupancy, material, count);
+        
+        if (!voxel::decodePlanes(copy.data(), copy.data() + count, count, encoded.data(), encoded.size()) || memcmp(copy.data(), occupancy, count) != 0 || memcmp(copy.data() + count, material, count) != 0)
+        {
+            fprintf(stderr, "Round trip failed for %s\n", volume);
+            return 1;
+        }
+        
+        double memcpyTime = measure(minTime, [&]() { memcpy(copy.data(), occupancy, count); memcpy(copy.data() + count, material, count); });
+        double encodeTime = measure(minTime, [&]() { voxel::encodePlanes(encoded, occupancy, material, count); });
+        double decodeTime = measure(minTime, [&]() { voxel::decodePlanes(copy.data(), copy.data() + count, count, encoded.data(), encoded.size()); });
+        
+        // chunk decoding also picks the chunk storage, which is what loading from a region file pays for
+        vector<vector<unsigned char>> chunks;
+        
+        if (size % voxel::kChunkSize == 0)
+            for (unsigned int cz = 0; cz < size; cz += voxel::kChunkSize)
+                for (unsigned int cy = 0; cy < size; cy += voxel::kChunkSize)
+                    for (unsigned int cx = 0; cx < size; cx += voxel::kChunkSize)
+                    {
+                        voxel::Chunk chunk;
+                        
+                        for (unsigned int z = 0; z < voxel::kChunkSize; ++z)
+                            for (unsigned int y = 0; y < voxel::kChunkSize; ++y)
+                            {
+                                size_t offset = cx + size * (cy + y + size * (cz + z));
+                                
+                                chunk.write(occupancy + offset, material + offset, 0, y, z, voxel::kChunkSize);
+                            }
+                        
+                        chunk.optimize();
+                        
+                        chunks.emplace_back();
+                        voxel::encodeChunk(chunks.back(), chunk);
+                    }
+        
+        double decodeChunkTime = chunks.empty() ? 0 : measure(minTime, [&]() {
+            voxel::Chunk chunk;
+            
+            for (auto& data: chunks)
+                voxel::decodeChunk(chunk, data.data(), data.size());
+        });
+        
+        printf("{\"volume\": \"%s\", \"size\": %u, \"rawBytes\": %zu, \"encodedBytes\": %zu, \"ratio\": %.2f, "
+            "\"memcpyGBPerSec\": %.2f, \"encodeGBPerSec\": %.2f, \"decodeGBPerSec\": %.2f, \"decodeChunkGBPerSec\": %.2f}\n",
+            volume, size, bytes, encoded.size(), double(bytes) / encoded.size(),
+            bytes / memcpyTime / 1e9, bytes / encodeTime / 1e9, bytes / decodeTime / 1e9, chunks.empty() ? 0 : bytes / decodeChunkTime / 1e9);
+        
+        fflush(stdout);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,118 @@
+#include "common.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <new>
+
+#include "voxel/box.hpp"
+#include "voxel/mesher.hpp"
+
+#include "benchvolumes.hpp"
+
+// heap accounting for allocation counts and peak memory per mesher call
+struct HeapStats
+{
+    size_t allocations;
+    size_t current;
+    size_t peak;
+};
+
+static HeapStats gHeap;
+
+void* operator new(size_t size)
+{
+    // keep the size in front of the block so that delete can account for it
+    void* ptr = malloc(size + 16);
+    if (!ptr) throw bad_alloc();
+    
+    *static_cast<size_t*>(ptr) = size;
+    
+    gHeap.allocations++;
+    gHeap.current += size;
+    gHeap.peak = max(gHeap.peak, gHeap.current);
+    
+    return static_cast<char*>(ptr) + 16;
+}
+
+void operator delete(void* ptr) noexcept
+{
+    if (!ptr) return;
+    
+    void* block = static_cast<char*>(ptr) - 16;
+    
+    gHeap.current -= *static_cast<size_t*>(block);
+    
+    free(block);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+    operator delete(ptr);
+}
+
+int main(int argc, char** argv)
+{
+    typedef chrono::high_resolution_clock Clock;
+    
+    unsigned int size = argc > 1 ? atoi(argv[1]) : 64;
+    double minTime = argc > 2 ? atof(argv[2]) : 0.5;
+    
+    const char* volumes[] = { "flat", "hills", "caves", "air", "solid", "checkerboard" };
+    
+    pair<const char*, unique_ptr<voxel::Mesher>> meshers[] =
+    {
+        make_pair("surfacenets", voxel::createMesherSurfaceNets()),
+        make_pair("marchingcubes", voxel::createMesherMarchingCubes()),
+    };
+    
+    for (auto& volume: volumes)
+    {
+        voxel::Box box = generateVolume(volume, size);
+        
+        for (auto& mesher: meshers)
+        {
+            // the first call warms up caches and is used for the memory figures
+            HeapStats before = gHeap;
+            gHeap.peak = gHeap.current;
+            
+            auto result = mesher.second->generate(box, vec3(0.f), 1, voxel::MeshOptions {});
+            
+            size_t allocations = gHeap.allocations - before.allocations;
+            size_t peakBytes = gHeap.peak - before.current;
+            size_t outputBytes = result.first.capacity() * sizeof(voxel::MeshVertex) + result.second.capacity() * sizeof(unsigned int);
+            
+            size_t vertices = result.first.size();
+            size_t triangles = result.second.size() / 3;
+            
+            result = {};
+            
+            unsigned int iterations = 0;
+            
+            Clock::time_point start = Clock::now();
+            double elapsed = 0;
+            
+            do
+            {
+                mesher.second->generate(box, vec3(0.f), 1, voxel::MeshOptions {});
+                
+                iterations++;
+                elapsed = chrono::duration<double>(Clock::now() - start).count();
+            }
+            while (elapsed < minTime);
+            
+            double perCall = elapsed / iterations;
+            double cells = double(size) * size * size;
+            
+            printf("{\"mesher\": \"%s\", \"volume\": \"%s\", \"size\": %u, \"iterations\": %u, \"secondsPerCall\": %.9f, "
+                "\"cellsPerSec\": %.0f, \"trianglesPerSec\": %.0f, \"vertices\": %zu, \"triangles\": %zu, "
+                "\"peakBytes\": %zu, \"scratchBytes\": %zu, \"allocations\": %zu}\n",
+                mesher.first, volume, size, iterations, perCall,
+                cells / perCall, triangles / perCall, vertices, triangles,
+                peakBytes, peakBytes > outputBytes ? peakBytes - outputBytes : 0, allocations);
+            
+            fflush(stdout);
+        }
+    }
+}
\ No newline at end of file
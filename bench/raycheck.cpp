@@ -0,0 +1,114 @@
+#include "common.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "voxel/grid.hpp"
+#include "voxel/mesher.hpp"
+#include "voxel/raycast.hpp"
+
+#include "benchvolumes.hpp"
+
+// Casts random rays with voxel::raycast and compares them against a brute force march through the trilinear
+// occupancy field in small steps; both should agree on whether the ray hits and where
+
+const int kVolumeSize = 64;
+
+const float kMarchStep = 0.002f;
+const float kDistanceTolerance = 0.01f;
+
+static float sampleField(const voxel::Box& box, const glm::i32vec3& offset, const vec3& p)
+{
+    glm::i32vec3 cube = glm::i32vec3(glm::floor(p));
+    vec3 t = p - vec3(cube);
+    
+    float c[8];
+    
+    for (int i = 0; i < 8; ++i)
+    {
+        glm::i32vec3 cell = cube + glm::i32vec3(i & 1, (i >> 1) & 1, i >> 2) - offset;
+        
+        bool inside = cell.x >= 0 && cell.y >= 0 && cell.z >= 0 && cell.x < kVolumeSize && cell.y < kVolumeSize && cell.z < kVolumeSize;
+        
+        c[i] = inside ? box.getOccupancy(cell.x, cell.y, cell.z) : 0;
+    }
+    
+    float c00 = glm::mix(c[0], c[1], t.x), c10 = glm::mix(c[2], c[3], t.x);
+    float c01 = glm::mix(c[4], c[5], t.x), c11 = glm::mix(c[6], c[7], t.x);
+    
+    return glm::mix(glm::mix(c00, c10, t.y), glm::mix(c01, c11, t.y), t.z);
+}
+
+static float randomFloat(float min, float max)
+{
+    return min + (max - min) * (rand() / float(RAND_MAX));
+}
+
+int main(int argc, char** argv)
+{
+    unsigned int rays = argc > 1 ? atoi(argv[1]) : 400;
+    
+    const char* volumes[] = { "hills", "caves" };
+    
+    unsigned int failures = 0;
+    
+    for (auto& volume: volumes)
+    {
+        // the volume is centered on the origin, and rays start in and around it
+        glm::i32vec3 offset(-kVolumeSize / 2);
+        
+        voxel::Box box = generateVolume(volume, kVolumeSize);
+        
+        voxel::Grid grid;
+        grid.write(voxel::Region(offset, kVolumeSize), box);
+        
+        srand(1);
+        
+        unsigned int hits = 0, mismatches = 0;
+        
+        for (unsigned int i = 0; i < rays; ++i)
+        {
+            vec3 origin(randomFloat(-48, 48), randomFloat(-48, 48), randomFloat(-48, 48));
+            vec3 direction(randomFloat(-1, 1), randomFloat(-1, 1), randomFloat(-1, 1));
+            
+            if (glm::length(direction) < 0.1f)
+                continue;
+            
+            direction = glm::normalize(direction);
+            
+            float maxDistance = 128;
+            
+            optional<voxel::RaycastHit> hit = voxel::raycast(grid, origin, direction, maxDistance);
+            
+            float expected = -1;
+            
+            for (float t = 0; t <= maxDistance; t += kMarchStep)
+                if (sampleField(box, offset, origin + direction * t) >= voxel::kIsolevel)
+                {
+                    expected = t;
+                    break;
+                }
+            
+            if (hit)
+                hits++;
+            
+            bool agree = hit ? (expected >= 0 && fabsf(hit->distance - expected) < kDistanceTolerance) : (expected < 0);
+            
+            if (!agree)
+            {
+                mismatches++;
+                
+                fprintf(stderr, "%s: ray (%f, %f, %f) -> (%f, %f, %f) hit at %f, expected %f\n",
+                    volume, origin.x, origin.y, origin.z, direction.x, direction.y, direction.z, hit ? hit->distance : -1.f, expected);
+            }
+        }
+        
+        printf("{\"volume\": \"%s\", \"rays\": %u, \"hits\": %u, \"mismatches\": %u}\n", volume, rays, hits, mismatches);
+        
+        fflush(stdout);
+        
+        failures += mismatches;
+    }
+    
+    return failures > 0;
+}
\ No newline at end of file
@@ -0,0 +1,177 @@
+#include "common.hpp"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <map>
+
+#include "voxel/grid.hpp"
+#include "voxel/lod.hpp"
+#include "voxel/mesher.hpp"
+
+#include "benchvolumes.hpp"
+
+// Meshes a level 1 node with transition cells next to the level 0 nodes across its transition faces and counts edges
+// of the combined mesh that have no opposite edge; a closed seam has none away from the outer border of the meshed nodes
+
+typedef array<vec3, 3> Triangle;
+
+static void addTriangles(vector<Triangle>& triangles, const pair<vector<voxel::MeshVertex>, vector<unsigned int>>& mesh)
+{
+    for (size_t i = 0; i < mesh.second.size(); i += 3)
+        triangles.push_back(Triangle { mesh.first[mesh.second[i + 0]].position, mesh.first[mesh.second[i + 1]].position, mesh.first[mesh.second[i + 2]].position });
+}
+
+static vector<Triangle> generateSeam(const voxel::Grid& grid, voxel::Mesher& mesher, unsigned int faces, bool transitions)
+{
+    voxel::MeshBorder border = mesher.getBorder();
+    
+    vector<Triangle> result;
+    
+    voxel::LodNode node { glm::i32vec3(0), 1 };
+    voxel::Region region = voxel::getLodNodeRegion(node);
+    voxel::Region boxRegion(region.begin() - border.before, region.end() + border.after);
+    
+    voxel::Box box = grid.read(boxRegion, 1);
+    voxel::Box transitionBox = grid.read(voxel::Region(region.begin() * 2 - 1, region.end() * 2 + 2), 0);
+    
+    voxel::MeshOptions options;
+    options.transitionFaces = transitions ? faces : 0;
+    options.transitionBox = &transitionBox;
+    
+    addTriangles(result, mesher.generate(box, vec3(boxRegion.begin() * 2), 2, options));
+    
+    // level 0 nodes around the coarse node that only border it through transition faces
+    for (int z = -1; z <= 2; ++z)
+        for (int y = -1; y <= 2; ++y)
+            for (int x = -1; x <= 2; ++x)
+            {
+                glm::i32vec3 id(x, y, z);
+                bool neighbour = true, inside = true;
+                
+                for (int axis = 0; axis < 3; ++axis)
+                {
+                    if (id[axis] < 0 && (faces & (1 << (axis * 2))) == 0)
+                        neighbour = false;
+                    
+                    if (id[axis] > 1 && (faces & (1 << (axis * 2 + 1))) == 0)
+                        neighbour = false;
+                    
+                    inside &= id[axis] >= 0 && id[axis] <= 1;
+                }
+                
+                if (inside || !neighbour)
+                    continue;
+                
+                voxel::Region fineRegion = voxel::Grid::getChunkRegion(id);
+                voxel::Region fineBoxRegion(fineRegion.begin() - border.before, fineRegion.end() + border.after);
+                
+                addTriangles(result, mesher.generate(grid.read(fineBoxRegion), vec3(fineBoxRegion.begin()), 1, voxel::MeshOptions()));
+            }
+    
+    return result;
+}
+
+static unsigned int countOpenEdges(const vector<Triangle>& triangles, unsigned int faces)
+{
+    // positions are welded on a fine lattice, since meshes of different nodes do not share vertices
+    map<tuple<long, long, long>, int> ids;
+    vector<vec3> positions;
+    
+    auto getId = [&](const vec3& p) {
+        auto key = make_tuple(lroundf(p.x * 4096), lroundf(p.y * 4096), lroundf(p.z * 4096));
+        auto it = ids.find(key);
+        
+        if (it != ids.end())
+            return it->second;
+        
+        positions.push_back(p);
+        
+        return ids[key] = int(positions.size() - 1);
+    };
+    
+    map<pair<int, int>, int> edges;
+    
+    for (auto& t: triangles)
+    {
+        int i0 = getId(t[0]), i1 = getId(t[1]), i2 = getId(t[2]);
+        
+        if (i0 == i1 || i1 == i2 || i0 == i2)
+            continue;
+        
+        edges[make_pair(i0, i1)]++;
+        edges[make_pair(i1, i2)]++;
+        edges[make_pair(i2, i0)]++;
+    }
+    
+    // the meshed nodes span 0..64 cells along axes without transition faces and extend by a fine node across the others
+    vec3 lower(0), upper(64);
+    
+    for (int axis = 0; axis < 3; ++axis)
+    {
+        if (faces & (1 << (axis * 2)))
+            lower[axis] = -32;
+        
+        if (faces & (1 << (axis * 2 + 1)))
+            upper[axis] = 96;
+    }
+    
+    unsigned int result = 0;
+    
+    for (auto& e: edges)
+    {
+        if (edges.count(make_pair(e.first.second, e.first.first)))
+            continue;
+        
+        const vec3& p0 = positions[e.first.first];
+        const vec3& p1 = positions[e.first.second];
+        
+        bool outer = false;
+        
+        for (int axis = 0; axis < 3; ++axis)
+            for (float bound: { lower[axis], upper[axis] })
+                outer |= fabsf(p0[axis] - bound) < 0.01f && fabsf(p1[axis] - bound) < 0.01f;
+        
+        if (!outer)
+            result++;
+    }
+    
+    return result;
+}
+
+int main(int argc, char** argv)
+{
+    const char* volumes[] = { "flat", "caves", "checkerboard" };
+    
+    // single faces, edges and corners between transition faces, and all faces
+    unsigned int faceMasks[] = { 1, 1 | 4, 1 | 4 | 16, 1 | 2 | 8 | 32, 63 };
+    
+    unique_ptr<voxel::Mesher> mesher = voxel::createMesherMarchingCubes();
+    
+    unsigned int failures = 0;
+    
+    for (auto& volume: volumes)
+    {
+        // the level 1 node covers cells 0..64, in the middle of the volume
+        voxel::Grid grid;
+        grid.write(voxel::Region(glm::i32vec3(-64), glm::i32vec3(128)), generateVolume(volume, 192));
+        
+        for (auto& faces: faceMasks)
+        {
+            vector<Triangle> seam = generateSeam(grid, *mesher, faces, true);
+            
+            unsigned int open = countOpenEdges(seam, faces);
+            unsigned int openWithout = countOpenEdges(generateSeam(grid, *mesher, faces, false), faces);
+            
+            printf("{\"volume\": \"%s\", \"faces\": %u, \"triangles\": %zu, \"openEdges\": %u, \"openEdgesWithoutTransitions\": %u}\n",
+                volume, faces, seam.size(), open, openWithout);
+            
+            fflush(stdout);
+            
+            if (open > 0)
+                failures++;
+        }
+    }
+    
+    return failures > 0;
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#include "common.hpp"
+#include "core/workerpool.hpp"
+
+WorkerPool::WorkerPool(unsigned int threadCount)
+{
+    assert(threadCount > 0);
+    
+    for (unsigned int i = 0; i < threadCount; ++i)
+        threads.emplace_back(bind(&WorkerPool::run, this));
+}
+
+WorkerPool::~WorkerPool()
+{
+    // empty job is a stop signal; each worker consumes exactly one
+    for (size_t i = 0; i < threads.size(); ++i)
+        jobs.push(function<void()>());
+    
+    for (auto& t: threads)
+        t.join();
+}
+
+void WorkerPool::push(const function<void()>& job)
+{
+    assert(job);
+    
+    jobs.push(job);
+}
+
+void WorkerPool::run()
+{
+    while (function<void()> job = jobs.pop())
+        job();
+}
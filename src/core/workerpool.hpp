@@ -0,0 +1,22 @@
+#pragma once
+
+#include "core/blockingqueue.hpp"
+
+#include <thread>
+
+class WorkerPool: noncopyable
+{
+public:
+    explicit WorkerPool(unsigned int threadCount);
+    ~WorkerPool();
+    
+    void push(const function<void()>& job);
+    
+    unsigned int getThreadCount() const { return threads.size(); }
+    
+private:
+    void run();
+    
+    BlockingQueue<function<void()>> jobs;
+    vector<thread> threads;
+};
@@ -1,6 +1,8 @@
 #include "common.hpp"
 #include "fs/folderwatcher.hpp"
 
+#ifdef __APPLE__
+
 #include <CoreServices/CoreServices.h>
 
 static void watchCallback(ConstFSEventStreamRef streamRef, void* clientCallBackInfo,
@@ -20,7 +22,7 @@ static void watchCallback(ConstFSEventStreamRef streamRef, void* clientCallBackI
     }
 }
 
-static void watcher(const string& path, BlockingQueue<string>* changeQueue, function<void()>* stopSignal)
+void FolderWatcher::watch(const string& path, BlockingQueue<string>* changeQueue, function<void()>* stopSignal)
 {
     pthread_setname_np("FolderWatcher");
     
@@ -45,15 +47,18 @@ static void watcher(const string& path, BlockingQueue<string>* changeQueue, func
 }
 
 FolderWatcher::FolderWatcher(const string& path)
-: watchThread(bind(watcher, path, &changeQueue, &stopSignal))
+: watchThread(bind(watch, path, &changeQueue, &stopSignal))
 {
 }
 
+#endif
+
 FolderWatcher::~FolderWatcher()
 {
     stopSignal();
     
-    watchThread.join();
+    if (watchThread.joinable())
+        watchThread.join();
 }
 
 void FolderWatcher::addListener(Listener *listener)
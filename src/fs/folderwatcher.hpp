@@ -24,9 +24,19 @@ public:
     void processChanges();
 
 private:
-    thread watchThread;
+#ifdef __linux__
+    // Runs on watchThread until the read end of the stop pipe becomes readable, then closes it
+    static void watch(const string& path, BlockingQueue<string>* changeQueue, int stopFd);
+#else
+    // Platform specific watch loop; runs on watchThread until stopSignal is called
+    static void watch(const string& path, BlockingQueue<string>* changeQueue, function<void()>* stopSignal);
+#endif
+    
     function<void()> stopSignal;
     
     BlockingQueue<string> changeQueue;
     unordered_set<Listener*> listeners;
+    
+    // started last, once the members it uses are constructed
+    thread watchThread;
 };
\ No newline at end of file
@@ -0,0 +1,205 @@
+#include "common.hpp"
+#include "fs/folderwatcher.hpp"
+
+#ifdef __linux__
+
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <cstring>
+#include <chrono>
+
+struct InotifyWatcher
+{
+    typedef chrono::steady_clock Clock;
+    
+    int fd;
+    
+    unordered_map<int, string> folders;
+    
+    // changed files are reported once no new events arrived for them within the latency window
+    unordered_map<string, Clock::time_point> pending;
+    
+    void addFolder(const string& path)
+    {
+        int wd = inotify_add_watch(fd, path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR);
+        
+        if (wd < 0)
+            return;
+        
+        folders[wd] = path;
+        
+        // inotify is not recursive, so every subfolder needs its own watch
+        if (DIR* dir = opendir(path.c_str()))
+        {
+            while (dirent* entry = readdir(dir))
+            {
+                if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                    continue;
+                
+                string child = path + "/" + entry->d_name;
+                
+                // some file systems do not report entry types
+                struct stat st;
+                
+                if (entry->d_type == DT_DIR || (entry->d_type == DT_UNKNOWN && stat(child.c_str(), &st) == 0 && S_ISDIR(st.st_mode)))
+                    addFolder(child);
+            }
+            
+            closedir(dir);
+        }
+    }
+    
+    void processEvents(const char* buffer, ssize_t length, Clock::time_point deadline)
+    {
+        for (const char* ptr = buffer; ptr < buffer + length; )
+        {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(ptr);
+            
+            ptr += sizeof(inotify_event) + event->len;
+            
+            if (event->mask & IN_IGNORED)
+            {
+                folders.erase(event->wd);
+                continue;
+            }
+            
+            auto it = folders.find(event->wd);
+            
+            if (it == folders.end() || event->len == 0)
+                continue;
+            
+            string path = it->second + "/" + event->name;
+            
+            if (event->mask & IN_ISDIR)
+            {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    addFolder(path);
+            }
+            else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+            {
+                // editors often save by writing a temporary file and renaming it over the original
+                pending[path] = deadline;
+            }
+        }
+    }
+    
+    void flush(BlockingQueue<string>* changeQueue, Clock::time_point now)
+    {
+        for (auto it = pending.begin(); it != pending.end(); )
+        {
+            if (it->second <= now)
+            {
+                // skip temporary files that were renamed or removed within the window
+                if (access(it->first.c_str(), F_OK) == 0)
+                    changeQueue->push(it->first);
+                
+                it = pending.erase(it);
+            }
+            else
+                ++it;
+        }
+    }
+    
+    int getTimeout(Clock::time_point now) const
+    {
+        if (pending.empty())
+            return -1;
+        
+        Clock::time_point next = Clock::time_point::max();
+        
+        for (auto& p: pending)
+            next = min(next, p.second);
+        
+        return next <= now ? 0 : int(chrono::duration_cast<chrono::milliseconds>(next - now).count()) + 1;
+    }
+};
+
+FolderWatcher::FolderWatcher(const string& path)
+{
+    int stopPipe[2];
+    
+    // without a stop pipe there is no way to end the watch loop, so changes are not watched at all
+    if (pipe2(stopPipe, O_CLOEXEC) != 0)
+    {
+        stopSignal = []() {};
+        return;
+    }
+    
+    // the signal is set before the thread starts, so the destructor never races with it or calls an empty function
+    stopSignal = [=]()
+    {
+        ssize_t rc = write(stopPipe[1], "", 1);
+        (void)rc;
+        
+        close(stopPipe[1]);
+    };
+    
+    watchThread = thread(watch, path, &changeQueue, stopPipe[0]);
+}
+
+void FolderWatcher::watch(const string& path, BlockingQueue<string>* changeQueue, int stopFd)
+{
+    pthread_setname_np(pthread_self(), "FolderWatcher");
+    
+    chrono::milliseconds latency(100);
+    
+    InotifyWatcher iw;
+    
+    bool stopped = false;
+    
+    iw.fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    
+    if (iw.fd >= 0)
+    {
+        iw.addFolder(path);
+        
+        alignas(inotify_event) char buffer[16384];
+        
+        for (;;)
+        {
+            pollfd fds[2] = { { stopFd, POLLIN, 0 }, { iw.fd, POLLIN, 0 } };
+            
+            int rc = poll(fds, 2, iw.getTimeout(InotifyWatcher::Clock::now()));
+            
+            if (rc < 0 && errno != EINTR)
+                break;
+            
+            if (fds[0].revents & POLLIN)
+            {
+                stopped = true;
+                break;
+            }
+            
+            if (fds[1].revents & POLLIN)
+            {
+                ssize_t length;
+                
+                while ((length = read(iw.fd, buffer, sizeof(buffer))) > 0)
+                    iw.processEvents(buffer, length, InotifyWatcher::Clock::now() + latency);
+            }
+            
+            iw.flush(changeQueue, InotifyWatcher::Clock::now());
+        }
+        
+        close(iw.fd);
+    }
+    
+    // without change notifications, keep the read end open until the stop signal so that it never writes to a closed pipe
+    if (!stopped)
+    {
+        char dummy;
+        
+        while (read(stopFd, &dummy, 1) < 0 && errno == EINTR)
+            ;
+    }
+    
+    close(stopFd);
+}
+
+#endif
\ No newline at end of file
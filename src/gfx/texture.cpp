@@ -11,7 +11,6 @@
 
 struct TextureFormatGL
 {
-    unsigned int bits;
     GLenum internalFormat;
     GLenum dataFormat;
     GLenum dataType;
@@ -31,14 +30,14 @@ static const GLenum kTextureTarget[Texture::Type_Count] =
 
 static const TextureFormatGL kTextureFormat[Texture::Format_Count] =
 {
-    { 8, GL_R8, GL_RED, GL_UNSIGNED_BYTE },
-	{ 32, GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
-	{ 64, GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT },
-	{ 64, GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0 },
-	{ 128, GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0 },
-	{ 128, GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0 },
-	{ 128, GL_COMPRESSED_RED_RGTC1, 0, 0 },
-	{ 128, GL_COMPRESSED_RG_RGTC2, 0, 0 },
+    { GL_R8, GL_RED, GL_UNSIGNED_BYTE },
+	{ GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE },
+	{ GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT },
+	{ GL_COMPRESSED_RGBA_S3TC_DXT1_EXT, 0, 0 },
+	{ GL_COMPRESSED_RGBA_S3TC_DXT3_EXT, 0, 0 },
+	{ GL_COMPRESSED_RGBA_S3TC_DXT5_EXT, 0, 0 },
+	{ GL_COMPRESSED_RED_RGTC1, 0, 0 },
+	{ GL_COMPRESSED_RG_RGTC2, 0, 0 },
 	{ GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8 },
 };
 
@@ -177,44 +176,6 @@ void Texture::bind(unsigned int stage)
     glBindTexture(target, id);
 }
 
-bool Texture::isFormatCompressed(Format format)
-{
-    return
-        format == Format_BC1 ||
-        format == Format_BC2 ||
-        format == Format_BC3 ||
-        format == Format_BC4 ||
-        format == Format_BC5;
-}
-
-bool Texture::isFormatDepth(Format format)
-{
-    return
-        format == Format_D24S8;
-}
-
-unsigned int Texture::getImageSize(Format format, unsigned int width, unsigned int height)
-{
-    const TextureFormatGL& desc = kTextureFormat[format];
-    
-    if (isFormatCompressed(format))
-        return ((width + 3) / 4) * ((height + 3) / 4) * (desc.bits / 8);
-    else
-        return width * height * (desc.bits / 8);
-}
-
-unsigned int Texture::getMipSide(unsigned int value, unsigned int mip)
-{
-    return max(value >> mip, 1u);
-}
-
-unsigned int Texture::getMaxMipCount(unsigned int width, unsigned int height, unsigned int depth)
-{
-    unsigned int side = max(width, max(height, depth));
-    
-    return sizeof(unsigned int) * 8 - __builtin_clz(side);
-}
-
 shared_ptr<Texture> TextureRef::emptyTexture = shared_ptr<Texture>();
 
 TextureRef::TextureRef(const shared_ptr<Texture>& texture)
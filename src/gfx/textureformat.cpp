@@ -0,0 +1,54 @@
+#include "common.hpp"
+#include "gfx/texture.hpp"
+
+// bits per pixel, or per 4x4 block for compressed formats
+static const unsigned int kTextureFormatBits[Texture::Format_Count] =
+{
+    8,
+    32,
+    64,
+    64,
+    128,
+    128,
+    128,
+    128,
+    32,
+};
+
+bool Texture::isFormatCompressed(Format format)
+{
+    return
+        format == Format_BC1 ||
+        format == Format_BC2 ||
+        format == Format_BC3 ||
+        format == Format_BC4 ||
+        format == Format_BC5;
+}
+
+bool Texture::isFormatDepth(Format format)
+{
+    return
+        format == Format_D24S8;
+}
+
+unsigned int Texture::getImageSize(Format format, unsigned int width, unsigned int height)
+{
+    unsigned int bits = kTextureFormatBits[format];
+    
+    if (isFormatCompressed(format))
+        return ((width + 3) / 4) * ((height + 3) / 4) * (bits / 8);
+    else
+        return width * height * (bits / 8);
+}
+
+unsigned int Texture::getMipSide(unsigned int value, unsigned int mip)
+{
+    return max(value >> mip, 1u);
+}
+
+unsigned int Texture::getMaxMipCount(unsigned int width, unsigned int height, unsigned int depth)
+{
+    unsigned int side = max(width, max(height, depth));
+    
+    return sizeof(unsigned int) * 8 - __builtin_clz(side);
+}
\ No newline at end of file
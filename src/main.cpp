@@ -6,6 +6,9 @@
 #include <stdlib.h>
 #include <stdio.h>
 
+#include <chrono>
+#include <deque>
+
 #include "gfx/program.hpp"
 #include "gfx/geometry.hpp"
 #include "gfx/texture.hpp"
@@ -20,8 +23,17 @@
 #include "fs/path.hpp"
 #include "fs/folderwatcher.hpp"
 
+#include "core/workerpool.hpp"
+
 #include "voxel/grid.hpp"
+#include "voxel/chunkstore.hpp"
+#include "voxel/edit.hpp"
 #include "voxel/mesher.hpp"
+#include "voxel/lod.hpp"
+#include "voxel/raycast.hpp"
+
+#include "physics/voxelshape.hpp"
+#include "physics/body.hpp"
 
 #include "glm/gtc/matrix_transform.hpp"
 #include "glm/gtc/type_ptr.hpp"
@@ -29,38 +41,11 @@
 #include "btBulletCollisionCommon.h"
 #include "btBulletDynamicsCommon.h"
 
-struct MeshPhysicsGeometry: btTriangleIndexVertexArray, noncopyable
-{
-    vector<vec3> vertices;
-    vector<unsigned int> indices;
-    
-    MeshPhysicsGeometry(const vector<voxel::MeshVertex>& vb, const vector<unsigned int>& ib)
-    {
-        vertices.reserve(vb.size());
-        for (auto& v: vb) vertices.push_back(v.position);
-        
-        indices = ib;
-        
-        btIndexedMesh mesh;
-        mesh.m_numTriangles = ib.size() / 3;
-        mesh.m_triangleIndexBase = reinterpret_cast<const unsigned char*>(indices.data());
-        mesh.m_triangleIndexStride = 3 * sizeof(unsigned int);
-        mesh.m_numVertices = vb.size();
-        mesh.m_vertexBase = reinterpret_cast<const unsigned char*>(vertices.data());
-        mesh.m_vertexStride = sizeof(vec3);
-
-        addIndexedMesh(mesh);
-    }
-};
-
 struct Mesh
 {
     unique_ptr<Geometry> geometry;
     unsigned int geometryIndices;
     
-    unique_ptr<MeshPhysicsGeometry> physicsGeometry;
-    unique_ptr<btCollisionShape> physicsShape;
-    
     static Mesh create(const vector<voxel::MeshVertex>& vb, const vector<unsigned int>& ib)
     {
         if (ib.empty())
@@ -78,125 +63,395 @@ struct Mesh
             Geometry::Element(offsetof(voxel::MeshVertex, normal), Geometry::Format_Float3),
         };
         
-        auto physicsGeometry = make_unique<MeshPhysicsGeometry>(vb, ib);
+        return Mesh { make_unique<Geometry>(layout, gvb, gib), static_cast<unsigned int>(ib.size()) };
+    }
+};
+
+unique_ptr<voxel::Mesher> createMesher(bool mmc)
+{
+    return mmc ? voxel::createMesherMarchingCubes() : voxel::createMesherSurfaceNets();
+}
+
+struct ChunkMeshResult
+{
+    voxel::LodNode node;
+    unsigned int version;
+    unsigned int transitionFaces;
+    
+    vector<voxel::MeshVertex> vertices;
+    vector<unsigned int> indices;
+    
+    double mesherTime;
+};
+
+shared_ptr<ChunkMeshResult> generateMesh(bool mmc, const voxel::LodNode& node, unsigned int version, const voxel::Box& box, const vec3& offset, float cellSize, unsigned int transitionFaces, const voxel::Box* transitionBox)
+{
+    typedef chrono::high_resolution_clock Clock;
+    
+    Clock::time_point start = Clock::now();
+    
+    voxel::MeshOptions options;
+    options.transitionFaces = transitionFaces;
+    options.transitionBox = transitionBox;
+    
+    auto p = createMesher(mmc)->generate(box, offset, cellSize, options);
+    
+    Clock::time_point end = Clock::now();
+    
+    shared_ptr<ChunkMeshResult> result = make_shared<ChunkMeshResult>();
+    
+    result->node = node;
+    result->version = version;
+    result->transitionFaces = transitionFaces;
+    
+    result->vertices = move(p.first);
+    result->indices = move(p.second);
+    
+    result->mesherTime = chrono::duration<double>(end - start).count();
+    
+    return result;
+}
+
+// node meshes are rebuilt from downsampled cells up to this level, with node size doubling per level
+const unsigned int kLodMaxLevel = 4;
+
+// nodes closer than this many node sizes to the camera are split into children
+const float kLodDetail = 2.f;
+
+unordered_set<voxel::LodNode> getDirtyNodes(const voxel::Region& region, bool mmc)
+{
+    voxel::MeshBorder border = createMesher(mmc)->getBorder();
+    
+    unordered_set<voxel::LodNode> result;
+    
+    // node mesh depends on the node cells plus the mesher border around them, at every level;
+    // transition cells also read one finer cell before the node, hence the extra cell
+    for (unsigned int level = 0; level <= kLodMaxLevel; ++level)
+    {
+        voxel::Region levelRegion = voxel::getLevelRegion(region, level);
         
-        unique_ptr<btCollisionShape> physicsShape(new btBvhTriangleMeshShape(physicsGeometry.get(), true));
+        for (auto& id: voxel::Grid::getChunkIds(voxel::Region(levelRegion.begin() - border.after, levelRegion.end() + border.before + 1)))
+            result.insert(voxel::LodNode { id, level });
+    }
+    
+    return result;
+}
+
+// Chunk id range of the world; edits only grow it, so it is tracked incrementally instead of scanning the grid
+struct WorldBounds
+{
+    bool empty = true;
+    glm::i32vec3 begin, end;
+    
+    void add(const glm::i32vec3& id)
+    {
+        begin = empty ? id : glm::min(begin, id);
+        end = empty ? id : glm::max(end, id);
+        empty = false;
+    }
     
-        return Mesh { make_unique<Geometry>(layout, gvb, gib), static_cast<unsigned int>(ib.size()), move(physicsGeometry), move(physicsShape) };
+    voxel::Region getRegion(const voxel::MeshBorder& border) const
+    {
+        if (empty)
+            return voxel::Region(glm::i32vec3(0), glm::i32vec3(0));
+        
+        // empty chunks next to the occupied ones still contain the surface
+        return voxel::Region(begin * int(voxel::kChunkSize) - border.after, (end + 1) * int(voxel::kChunkSize) + border.before);
     }
 };
 
-struct PhysicsBody
+class ChunkMeshes: noncopyable
 {
-    btDynamicsWorld* world;
-    
-    btDefaultMotionState motionState;
-    btRigidBody* rigidBody;
+public:
+    explicit ChunkMeshes(unsigned int threadCount)
+    : workers(threadCount)
+    {
+    }
     
-    PhysicsBody(btDynamicsWorld* world, btCollisionShape* shape, float mass)
-    : world(world)
-    , rigidBody(nullptr)
+    // Sets the node cut to display; missing nodes are requested, and the cut is swapped in once all of them are meshed
+    void select(bool mmc, const vector<voxel::LodNode>& cut)
     {
-        btVector3 localInertia;
+        selection = unordered_set<voxel::LodNode>(cut.begin(), cut.end());
         
-        if (mass > 0)
-            shape->calculateLocalInertia(mass, localInertia);
-        else
-            localInertia = btVector3(0, 0, 0);
+        for (auto& id: cut)
+        {
+            Node& node = nodes[id];
+            
+            // only marching cubes stitches nodes of different levels
+            node.faces = mmc ? voxel::getLodTransitionFaces(selection, id) : 0;
+            
+            if (node.pending ? node.queuedFaces != node.faces : (!node.mesh || node.meshFaces != node.faces))
+                request(id, node);
+        }
+    }
+    
+    // Requests dirty nodes that are displayed or about to be; other cached meshes are dropped and rebuilt on demand
+    void update(const unordered_set<voxel::LodNode>& dirty)
+    {
+        for (auto& id: dirty)
+        {
+            auto it = nodes.find(id);
+            
+            if (it == nodes.end())
+                continue;
+            
+            if (instances.count(id) || selection.count(id) || it->second.pending)
+                request(id, it->second);
+            else
+                nodes.erase(it);
+        }
+    }
+    
+    // Requests all known nodes, e.g. after the mesher changes
+    void invalidate()
+    {
+        unordered_set<voxel::LodNode> dirty;
         
-        btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, &motionState, shape, localInertia);
+        for (auto& p: nodes)
+            dirty.insert(p.first);
         
-        rigidBody = new btRigidBody(rbInfo);
+        update(dirty);
+    }
+    
+    // Reads grid snapshots for requested nodes and queues them for meshing until the time budget (in seconds) runs out;
+    // reads can page chunks in and rebuild mips, so the rest of the requests wait for the next frame
+    void snapshot(const voxel::Grid& grid, bool mmc, double budget)
+    {
+        double start = glfwGetTime();
         
-        world->addRigidBody(rigidBody);
+        while (!requests.empty() && glfwGetTime() - start < budget)
+        {
+            voxel::LodNode id = requests.front();
+            requests.pop_front();
+            
+            auto it = nodes.find(id);
+            
+            // node was dropped or already snapshotted through an earlier request
+            if (it == nodes.end() || !it->second.requested)
+                continue;
+            
+            it->second.requested = false;
+            
+            queue(grid, mmc, id, it->second);
+        }
     }
     
-    ~PhysicsBody()
+    // Uploads finished meshes and swaps node instances until the time budget (in seconds) runs out
+    void commit(double budget)
     {
-        world->removeRigidBody(rigidBody);
-        delete rigidBody;
+        double start = glfwGetTime();
+        
+        int chunks = 0;
+        double mesherTime = 0;
+        
+        shared_ptr<ChunkMeshResult> result;
+        
+        while (glfwGetTime() - start < budget && results.pop(result))
+        {
+            auto it = nodes.find(result->node);
+            
+            // node was queued again after this snapshot was taken
+            if (it == nodes.end() || result->version != it->second.version)
+                continue;
+            
+            Node& node = it->second;
+            
+            node.pending = false;
+            node.mesh = make_shared<Mesh>(Mesh::create(result->vertices, result->indices));
+            node.meshFaces = result->transitionFaces;
+            
+            // displayed nodes are replaced right away
+            auto iit = instances.find(result->node);
+            
+            if (iit != instances.end())
+                iit->second = node.mesh;
+            
+            chunks++;
+            mesherTime += result->mesherTime;
+        }
+        
+        swapSelection();
+        
+        if (chunks > 0)
+            printf("Chunk update: %d chunks, mesher %.1f msec, commit %.1f msec\n", chunks, mesherTime * 1000, (glfwGetTime() - start) * 1000);
     }
-};
-
-struct MeshInstance
-{
-    shared_ptr<Mesh> mesh;
-    unique_ptr<PhysicsBody> body;
-};
-
-MeshInstance generateMesh(btDynamicsWorld* world, const voxel::Grid& grid, bool mmc)
-{
-    unique_ptr<voxel::Mesher> mesher = mmc ? voxel::createMesherMarchingCubes() : voxel::createMesherSurfaceNets();
     
-    voxel::Box box = grid.read(voxel::Region(glm::i32vec3(-32, -32, 0), glm::i32vec3(32, 32, 32)));
+    const unordered_map<voxel::LodNode, shared_ptr<Mesh>>& getInstances() const { return instances; }
+    
+private:
+    struct Node
+    {
+        shared_ptr<Mesh> mesh;
+        unsigned int meshFaces = 0;
+        
+        // transition faces wanted by the selection and requested from the pending mesh
+        unsigned int faces = 0;
+        unsigned int queuedFaces = 0;
+        
+        unsigned int version = 0;
+        bool pending = false;
+        
+        // waiting for a grid snapshot
+        bool requested = false;
+    };
     
-    clock_t start = clock();
+    void request(const voxel::LodNode& id, Node& node)
+    {
+        // results of earlier snapshots are stale from now on
+        ++node.version;
+        
+        node.pending = true;
+        node.queuedFaces = node.faces;
+        
+        if (!node.requested)
+        {
+            node.requested = true;
+            requests.push_back(id);
+        }
+    }
     
-    auto p = mesher->generate(box, vec3(-32, -32, 0), 1, voxel::MeshOptions {});
+    void queue(const voxel::Grid& grid, bool mmc, const voxel::LodNode& id, Node& node)
+    {
+        voxel::MeshBorder border = createMesher(mmc)->getBorder();
+        
+        unsigned int version = node.version;
+        unsigned int faces = node.faces;
+        
+        node.queuedFaces = faces;
+        
+        voxel::Region region = voxel::getLodNodeRegion(id);
+        voxel::Region boxRegion(region.begin() - border.before, region.end() + border.after);
+        
+        int scale = 1 << id.level;
+        
+        // uniform regions have no surface; skip the snapshot and the worker round trip
+        if (grid.getUniformCell(voxel::Region(boxRegion.begin() * scale, boxRegion.end() * scale)))
+        {
+            shared_ptr<ChunkMeshResult> result = make_shared<ChunkMeshResult>();
+            
+            result->node = id;
+            result->version = version;
+            result->transitionFaces = faces;
+            result->mesherTime = 0;
+            
+            results.push(result);
+            return;
+        }
+        
+        shared_ptr<voxel::Box> box = make_shared<voxel::Box>(grid.read(boxRegion, id.level));
+        vec3 offset = vec3(boxRegion.begin() * scale);
+        
+        // transition cells sample the finer neighbours at twice the resolution, one fine cell past the node on every side
+        shared_ptr<voxel::Box> transitionBox;
+        
+        if (faces)
+            transitionBox = make_shared<voxel::Box>(grid.read(voxel::Region(region.begin() * 2 - 1, region.end() * 2 + 2), id.level - 1));
+        
+        workers.push([=]() { results.push(generateMesh(mmc, id, version, *box, offset, scale, faces, transitionBox.get())); });
+    }
     
-    clock_t middle = clock();
+    void swapSelection()
+    {
+        if (selection.size() == instances.size() && all_of(selection.begin(), selection.end(), [&](const voxel::LodNode& id) { return instances.count(id); }))
+            return;
+        
+        for (auto& id: selection)
+        {
+            const Node& node = nodes[id];
+            
+            if (!node.mesh || node.meshFaces != node.faces)
+                return;
+        }
+        
+        unordered_map<voxel::LodNode, shared_ptr<Mesh>> newInstances;
+        
+        for (auto& id: selection)
+            newInstances[id] = nodes[id].mesh;
+        
+        instances = move(newInstances);
+        
+        // meshes outside of the cut are rebuilt when the camera comes back; pending nodes keep their versions
+        for (auto it = nodes.begin(); it != nodes.end(); )
+        {
+            if (instances.count(it->first))
+                ++it;
+            else if (it->second.pending)
+                (it++)->second.mesh.reset();
+            else
+                it = nodes.erase(it);
+        }
+    }
     
-    shared_ptr<Mesh> mesh = make_shared<Mesh>(Mesh::create(p.first, p.second));
-    unique_ptr<PhysicsBody> body = make_unique<PhysicsBody>(world, mesh->physicsShape.get(), 0.f);
+    unordered_set<voxel::LodNode> selection;
+    unordered_map<voxel::LodNode, Node> nodes;
     
-    clock_t end = clock();
+    deque<voxel::LodNode> requests;
     
-    printf("Chunk update: mesher %.1f msec, physics %.1f msec\n", (middle - start) * 1000.0 / CLOCKS_PER_SEC, (end - middle) * 1000.0 / CLOCKS_PER_SEC);
+    unordered_map<voxel::LodNode, shared_ptr<Mesh>> instances;
     
-    return { mesh, move(body) };
-}
+    BlockingQueue<shared_ptr<ChunkMeshResult>> results;
+    WorkerPool workers;
+};
 
 void generateWorld(voxel::Grid& grid)
 {
     voxel::Box box(64, 64, 32);
+    voxel::BoxPlane<unsigned char> occupancy = box.getOccupancy();
     
+    // materials stay 0
     for (int z = 0; z < box.getDepth(); ++z)
         for (int y = 0; y < box.getHeight(); ++y)
             for (int x = 0; x < box.getWidth(); ++x)
             {
-                voxel::Cell& c = box(x, y, z);
-                
                 float hill = ((x - 32) / 8.f) * ((x - 32) / 8.f) + ((y - 32) / 8.f) * ((y - 32) / 8.f);
                 
-                c.occupancy = (z < 5) ? 255 : (z > 10) ? 0 : (1.f - glm::clamp(sqrtf(hill), 0.f, 1.f)) * 255;
-                c.material = 0;
+                occupancy(x, y, z) = (z < 5) ? 255 : (z > 10) ? 0 : (1.f - glm::clamp(sqrtf(hill), 0.f, 1.f)) * 255;
             }
     
     for (int i = 0; i < 8; ++i)
     {
-        box(20 + i * 2, 16, 5).occupancy = 255 >> i;
+        occupancy(20 + i * 2, 16, 5) = 255 >> i;
         
-        box(20 + i * 3, 18, 10).occupancy = 255 >> i;
-        box(20 + i * 2, 20, 10).occupancy = 255 >> i;
-        box(20 + i * 1, 22, 10).occupancy = 255 >> i;
+        occupancy(20 + i * 3, 18, 10) = 255 >> i;
+        occupancy(20 + i * 2, 20, 10) = 255 >> i;
+        occupancy(20 + i * 1, 22, 10) = 255 >> i;
     }
     
     grid.write(voxel::Region(glm::i32vec3(-32, -32, 0), glm::i32vec3(32, 32, 32)), box);
 }
 
-void brushWorld(voxel::Grid& grid, const vec3& position, float radius, bool additive)
+unordered_set<voxel::LodNode> brushWorld(voxel::Grid& grid, WorldBounds& bounds, VoxelPhysicsShape& shape, const vec3& position, float radius, bool additive, bool mmc)
 {
     glm::i32vec3 min = glm::i32vec3(glm::floor(position - radius));
     glm::i32vec3 max = glm::i32vec3(glm::ceil(position + radius));
     voxel::Region region(min, max);
     
-    voxel::Box box = grid.read(region);
+    voxel::Edit edit;
     
-    for (int z = 0; z < box.getDepth(); ++z)
-        for (int y = 0; y < box.getHeight(); ++y)
-            for (int x = 0; x < box.getWidth(); ++x)
-            {
-                voxel::Cell& c = box(x, y, z);
-                
-                float r = glm::distance(position, vec3(x, y, z) + vec3(min));
-                
-                if (additive)
-                    c.occupancy = std::max(c.occupancy + 0, static_cast<int>(glm::clamp(1 - r / radius, 0.f, 1.f) * 10.f));
-                else
-                    c.occupancy = std::min(c.occupancy + 0, static_cast<int>(glm::clamp(r / radius - 1, 0.f, 1.f) * 200.f));
-            }
+    edit.apply(region, [=](const glm::i32vec3& p, voxel::Cell& c) {
+        float r = glm::distance(position, vec3(p));
+        
+        if (additive)
+            c.occupancy = std::max(c.occupancy + 0, static_cast<int>(glm::clamp(1 - r / radius, 0.f, 1.f) * 10.f));
+        else
+            c.occupancy = std::min(c.occupancy + 0, static_cast<int>(glm::clamp(r / radius - 1, 0.f, 1.f) * 200.f));
+    });
+    
+    unordered_set<voxel::LodNode> dirty;
+    
+    // only chunks the edit actually changed need their meshes (and neighbours) rebuilt
+    for (auto& cid: grid.apply(edit))
+    {
+        voxel::Region changed = voxel::Grid::getChunkRegion(cid).intersect(region);
+        
+        bounds.add(cid);
+        shape.invalidate(changed);
+        
+        for (auto& did: getDirtyNodes(changed, mmc))
+            dirty.insert(did);
+    }
     
-    grid.write(region, box);
+    return dirty;
 }
 
 pair<unique_ptr<Geometry>, unsigned int> generateSphere(float radius)
@@ -250,6 +505,12 @@ pair<unique_ptr<Geometry>, unsigned int> generateSphere(float radius)
     return make_pair(make_unique<Geometry>(layout, gvb, gib), ib.size());
 }
 
+const double kChunkCommitBudget = 0.004;
+const double kChunkSnapshotBudget = 0.004;
+
+// chunks beyond this are compressed, then paged out to the world store
+const size_t kGridMemoryBudget = 512 << 20;
+
 bool wireframe = false;
 Camera camera;
 vec3 cameraAngles;
@@ -400,10 +661,41 @@ int main(int argc, const char** argv)
 	
 	dynamicsWorld.setGravity(btVector3(0,-10,0));
 
+    // the world is saved next to the data folder; a missing or empty world is generated from scratch
+    unique_ptr<voxel::ChunkStore> store;
+    
+    try
+    {
+        store = make_unique<voxel::ChunkStore>(basePath + "/world");
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "Failed to open the world: %s\n", e.what());
+        
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+    
     voxel::Grid grid;
-    generateWorld(grid);
+    grid.setStore(store.get());
+    grid.setMemoryBudget(kGridMemoryBudget);
+    
+    if (grid.getChunks().empty())
+        generateWorld(grid);
+    
+    WorldBounds worldBounds;
+    
+    for (auto& id: grid.getChunks())
+        worldBounds.add(id);
+    
+    voxel::MeshBorder mesherBorder = createMesher(mesherMC)->getBorder();
+    
+    ChunkMeshes chunks(max(thread::hardware_concurrency(), 2u) - 1);
     
-    MeshInstance chunk = generateMesh(&dynamicsWorld, grid, mesherMC);
+    // terrain collides with the full resolution cells regardless of the displayed LOD
+    VoxelPhysicsShape terrainShape(&grid, createMesher(mesherMC));
+    PhysicsBody terrainBody(&dynamicsWorld, &terrainShape, 0.f);
     
     ui::Renderer uir(fonts, pm.get("ui-vs", "ui-fs"));
     
@@ -481,20 +773,19 @@ int main(int argc, const char** argv)
             vec3 w0(pw0 / pw0.w);
             vec3 w1(pw1 / pw1.w);
             
-            btDynamicsWorld::ClosestRayResultCallback callback(btVector3(w0.x, w0.y, w0.z), btVector3(w1.x, w1.y, w1.z));
-            
-            dynamicsWorld.rayTest(callback.m_rayFromWorld, callback.m_rayToWorld, callback);
-            
-            if (callback.hasHit())
+            // picking reads the grid directly, so it sees edits before the meshes are rebuilt
+            if (auto hit = voxel::raycast(grid, w0, glm::normalize(w1 - w0), glm::distance(w0, w1)))
             {
-                vec3 hitPos = vec3(callback.m_hitPointWorld.getX(), callback.m_hitPointWorld.getY(), callback.m_hitPointWorld.getZ());
+                vec3 hitPos = hit->position;
                 
                 if (mouseDown[GLFW_MOUSE_BUTTON_LEFT])
                 {
                     brushPosition = glm::mix(brushPosition, hitPos, 0.1f);
                     
-                    brushWorld(grid, brushPosition, brushRadius, brushAdditive);
-                    chunk = generateMesh(&dynamicsWorld, grid, mesherMC);
+                    unordered_set<voxel::LodNode> dirty = brushWorld(grid, worldBounds, terrainShape, brushPosition, brushRadius, brushAdditive, mesherMC);
+                    
+                    if (!dirty.empty())
+                        chunks.update(dirty);
                 }
                 else
                 {
@@ -506,8 +797,20 @@ int main(int argc, const char** argv)
         if (mesherMCChanged)
         {
             mesherMCChanged = false;
-            chunk = generateMesh(&dynamicsWorld, grid, mesherMC);
+            
+            chunks.invalidate();
+            terrainShape.setMesher(createMesher(mesherMC));
+            
+            mesherBorder = createMesher(mesherMC)->getBorder();
         }
+        
+        chunks.select(mesherMC, voxel::selectLodNodes(worldBounds.getRegion(mesherBorder), camera.getPosition(), kLodDetail, kLodMaxLevel));
+        
+        chunks.snapshot(grid, mesherMC, kChunkSnapshotBudget);
+        chunks.commit(kChunkCommitBudget);
+        
+        // no grid views outlive the frame update, so chunks can be compressed or evicted here
+        grid.trim();
  
         glViewport(0, 0, framebufferWidth, framebufferHeight);
         glClearColor(168.f / 255.f, 197.f / 255.f, 236.f / 255.f, 1.0f);
@@ -531,8 +834,9 @@ int main(int argc, const char** argv)
             glUniform1i(prog->getHandle("AlbedoSide"), 1);
             glUniformMatrix4fv(prog->getHandle("ViewProjection"), 1, false, glm::value_ptr(viewproj));
             
-            if (chunk.mesh->geometry)
-                chunk.mesh->geometry->draw(Geometry::Primitive_Triangles, 0, chunk.mesh->geometryIndices);
+            for (auto& p: chunks.getInstances())
+                if (p.second->geometry)
+                    p.second->geometry->draw(Geometry::Primitive_Triangles, 0, p.second->geometryIndices);
         }
         
         if (Program* prog = pm.get("brush-vs", "brush-fs"))
@@ -562,11 +866,29 @@ int main(int argc, const char** argv)
         uir.rect(vec2(10, 10), vec2(200, 400), 2, vec4(0.4, 0.4, 0.4, 0.75));
         uir.text(vec2(17, 15), "sans", "Algorithm: " + string(mesherMC ? "Marching Cubes" : "Surface Nets"), 18, vec4(1));
         
+        {
+            voxel::GridStats stats = grid.getStats();
+            
+            char text[128];
+            snprintf(text, sizeof(text), "Grid: %d MB, %d dense, %d compressed", int(stats.memoryUsage >> 20), int(stats.denseChunks), int(stats.compressedChunks));
+            
+            uir.text(vec2(17, 37), "sans", text, 18, vec4(1));
+        }
+        
         uir.end();
         
         glfwSwapBuffers(window);
     }
     
+    try
+    {
+        grid.save();
+    }
+    catch (const exception& e)
+    {
+        fprintf(stderr, "Failed to save the world: %s\n", e.what());
+    }
+    
     glfwDestroyWindow(window);
     
     glfwTerminate();
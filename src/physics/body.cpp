@@ -0,0 +1,26 @@
+#include "common.hpp"
+#include "physics/body.hpp"
+
+PhysicsBody::PhysicsBody(btDynamicsWorld* world, btCollisionShape* shape, float mass)
+: world(world)
+, rigidBody(nullptr)
+{
+    btVector3 localInertia;
+    
+    if (mass > 0)
+        shape->calculateLocalInertia(mass, localInertia);
+    else
+        localInertia = btVector3(0, 0, 0);
+    
+    btRigidBody::btRigidBodyConstructionInfo rbInfo(mass, &motionState, shape, localInertia);
+    
+    rigidBody = new btRigidBody(rbInfo);
+    
+    world->addRigidBody(rigidBody);
+}
+
+PhysicsBody::~PhysicsBody()
+{
+    world->removeRigidBody(rigidBody);
+    delete rigidBody;
+}
\ No newline at end of file
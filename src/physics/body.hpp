@@ -0,0 +1,15 @@
+#pragma once
+
+#include "btBulletDynamicsCommon.h"
+
+// Rigid body that is added to the world for its lifetime
+struct PhysicsBody: noncopyable
+{
+    btDynamicsWorld* world;
+    
+    btDefaultMotionState motionState;
+    btRigidBody* rigidBody;
+    
+    PhysicsBody(btDynamicsWorld* world, btCollisionShape* shape, float mass);
+    ~PhysicsBody();
+};
\ No newline at end of file
@@ -0,0 +1,44 @@
+#include "common.hpp"
+#include "physics/meshgeometry.hpp"
+
+MeshPhysicsGeometry::MeshPhysicsGeometry(const vector<voxel::MeshVertex>& vb, const vector<unsigned int>& ib)
+{
+    vertices.reserve(vb.size());
+    for (auto& v: vb) vertices.push_back(v.position);
+    
+    indices = ib;
+    
+    btIndexedMesh mesh;
+    mesh.m_numTriangles = ib.size() / 3;
+    mesh.m_triangleIndexBase = reinterpret_cast<const unsigned char*>(indices.data());
+    mesh.m_triangleIndexStride = 3 * sizeof(unsigned int);
+    mesh.m_numVertices = vb.size();
+    mesh.m_vertexBase = reinterpret_cast<const unsigned char*>(vertices.data());
+    mesh.m_vertexStride = sizeof(vec3);
+
+    addIndexedMesh(mesh);
+}
+
+bool MeshPhysicsGeometry::hasSameTopology(const vector<voxel::MeshVertex>& vb, const vector<unsigned int>& ib) const
+{
+    return vertices.size() == vb.size() && indices == ib;
+}
+
+void MeshPhysicsGeometry::refit(btBvhTriangleMeshShape& shape, const vector<voxel::MeshVertex>& vb)
+{
+    assert(vertices.size() == vb.size() && !vb.empty());
+    
+    vec3 min = vb[0].position;
+    vec3 max = vb[0].position;
+    
+    for (size_t i = 0; i < vb.size(); ++i)
+    {
+        vertices[i] = vb[i].position;
+        
+        min = glm::min(min, vb[i].position);
+        max = glm::max(max, vb[i].position);
+    }
+    
+    // quantization bounds are reset from the new bounds, so vertices may move anywhere; the node layout is kept
+    shape.refitTree(btVector3(min.x, min.y, min.z), btVector3(max.x, max.y, max.z));
+}
\ No newline at end of file
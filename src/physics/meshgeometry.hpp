@@ -0,0 +1,20 @@
+#pragma once
+
+#include "voxel/mesher.hpp"
+
+#include "btBulletCollisionCommon.h"
+
+// Triangle mesh storage for Bullet shapes; keeps positions and indices alive for the shape lifetime
+struct MeshPhysicsGeometry: btTriangleIndexVertexArray, noncopyable
+{
+    vector<vec3> vertices;
+    vector<unsigned int> indices;
+    
+    MeshPhysicsGeometry(const vector<voxel::MeshVertex>& vb, const vector<unsigned int>& ib);
+    
+    // Returns true if the mesh has the same triangles, so that shapes can be refit instead of rebuilt
+    bool hasSameTopology(const vector<voxel::MeshVertex>& vb, const vector<unsigned int>& ib) const;
+    
+    // Replaces vertex positions of a mesh with the same topology and refits the shape built on this geometry
+    void refit(btBvhTriangleMeshShape& shape, const vector<voxel::MeshVertex>& vb);
+};
\ No newline at end of file
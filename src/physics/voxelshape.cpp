@@ -0,0 +1,193 @@
+#include "common.hpp"
+#include "physics/voxelshape.hpp"
+#include "physics/meshgeometry.hpp"
+
+#include "voxel/grid.hpp"
+#include "voxel/gridview.hpp"
+
+#include "LinearMath/btAabbUtil2.h"
+
+// the grid has no fixed bounds; this only has to cover everything that can collide with it
+const float kVoxelShapeExtent = 1e6f;
+
+// cached chunks beyond this are dropped unless the current query uses them, e.g. after long rays
+const size_t kVoxelShapeCacheSize = 1024;
+
+// Forwards chunk triangles in grid space with the shape scaling applied
+struct ScaledTriangleCallback: btTriangleCallback
+{
+    btTriangleCallback* callback;
+    btVector3 scaling;
+    
+    int nextIndex = 0;
+    
+    ScaledTriangleCallback(btTriangleCallback* callback, const btVector3& scaling)
+    : callback(callback)
+    , scaling(scaling)
+    {
+    }
+    
+    void processTriangle(btVector3* triangle, int partId, int triangleIndex) override
+    {
+        btVector3 scaled[3] = { triangle[0] * scaling, triangle[1] * scaling, triangle[2] * scaling };
+        
+        callback->processTriangle(scaled, 0, nextIndex++);
+    }
+};
+
+VoxelPhysicsShape::VoxelPhysicsShape(const voxel::Grid* grid, unique_ptr<voxel::Mesher> mesher)
+: grid(grid)
+, mesher(move(mesher))
+, localScaling(1, 1, 1)
+{
+    m_shapeType = CUSTOM_CONCAVE_SHAPE_TYPE;
+}
+
+VoxelPhysicsShape::~VoxelPhysicsShape()
+{
+}
+
+void VoxelPhysicsShape::setMesher(unique_ptr<voxel::Mesher> mesher)
+{
+    this->mesher = move(mesher);
+    
+    chunks.clear();
+}
+
+void VoxelPhysicsShape::invalidate(const voxel::Region& region)
+{
+    voxel::MeshBorder border = mesher->getBorder();
+    
+    // chunk meshes also read the border cells around the chunk
+    for (auto& id: voxel::Grid::getChunkIds(voxel::Region(region.begin() - border.after, region.end() + border.before)))
+    {
+        auto it = chunks.find(id);
+        
+        if (it != chunks.end())
+            it->second.stale = true;
+    }
+}
+
+void VoxelPhysicsShape::getAabb(const btTransform& t, btVector3& aabbMin, btVector3& aabbMax) const
+{
+    btVector3 extent(kVoxelShapeExtent, kVoxelShapeExtent, kVoxelShapeExtent);
+    
+    btTransformAabb(-extent, extent, getMargin(), t, aabbMin, aabbMax);
+}
+
+void VoxelPhysicsShape::processAllTriangles(btTriangleCallback* callback, const btVector3& aabbMin, const btVector3& aabbMax) const
+{
+    btVector3 min = btVector3(aabbMin.x() / localScaling.x(), aabbMin.y() / localScaling.y(), aabbMin.z() / localScaling.z());
+    btVector3 max = btVector3(aabbMax.x() / localScaling.x(), aabbMax.y() / localScaling.y(), aabbMax.z() / localScaling.z());
+    
+    // triangles of a cell can reach into the neighbouring cells
+    voxel::Region region(glm::i32vec3(glm::floor(vec3(min.x(), min.y(), min.z()))) - 1, glm::i32vec3(glm::floor(vec3(max.x(), max.y(), max.z()))) + 2);
+    
+    queryEpoch++;
+    
+    ScaledTriangleCallback scaledCallback(callback, localScaling);
+    
+    voxel::MeshBorder border = mesher->getBorder();
+    
+    // large boxes (e.g. for long rays) mostly cover chunks without a surface; these are skipped before they get
+    // a cache entry, and chunks that only exist in the store are not paged in unless they can produce triangles
+    for (auto& cid: voxel::Grid::getChunkIds(region))
+    {
+        auto it = chunks.find(cid);
+        
+        if (it == chunks.end())
+        {
+            voxel::Region cells = voxel::Grid::getChunkRegion(cid);
+            voxel::Region boxRegion(cells.begin() - border.before, cells.end() + border.after);
+            
+            vector<glm::i32vec3> ids = voxel::Grid::getChunkIds(boxRegion);
+            
+            if (none_of(ids.begin(), ids.end(), [&](const glm::i32vec3& id) { return grid->hasChunk(id); }))
+                continue;
+            
+            if (grid->getUniformCell(boxRegion))
+                continue;
+        }
+        
+        const ChunkTriangles& triangles = getChunkTriangles(cid);
+        
+        if (triangles.shape)
+            triangles.shape->processAllTriangles(&scaledCallback, min, max);
+    }
+    
+    if (chunks.size() > kVoxelShapeCacheSize)
+    {
+        for (auto it = chunks.begin(); it != chunks.end(); )
+        {
+            if (it->second.lastQuery != queryEpoch)
+                it = chunks.erase(it);
+            else
+                ++it;
+        }
+    }
+}
+
+VoxelPhysicsShape::ChunkTriangles& VoxelPhysicsShape::getChunkTriangles(const glm::i32vec3& id) const
+{
+    auto it = chunks.find(id);
+    
+    if (it == chunks.end())
+        it = chunks.emplace(id, ChunkTriangles { nullptr, nullptr, 0, true }).first;
+    
+    ChunkTriangles& triangles = it->second;
+    
+    triangles.lastQuery = queryEpoch;
+    
+    if (!triangles.stale)
+        return triangles;
+    
+    triangles.stale = false;
+    
+    // chunks are meshed whole, so the triangles match the level 0 render mesh and stay valid for any query box
+    voxel::MeshBorder border = mesher->getBorder();
+    voxel::Region cells = voxel::Grid::getChunkRegion(id);
+    voxel::Region boxRegion(cells.begin() - border.before, cells.end() + border.after);
+    
+    pair<vector<voxel::MeshVertex>, vector<unsigned int>> p;
+    
+    if (!grid->getUniformCell(boxRegion))
+    {
+        voxel::GridView view(*grid, boxRegion);
+        
+        p = mesher->generate(view, vec3(boxRegion.begin()), 1.f, voxel::MeshOptions());
+    }
+    
+    if (triangles.geometry && triangles.geometry->hasSameTopology(p.first, p.second))
+    {
+        // edits that only move vertices keep the BVH layout
+        triangles.geometry->refit(*triangles.shape, p.first);
+    }
+    else
+    {
+        // the shape references the geometry, so it goes first
+        triangles.shape.reset();
+        triangles.geometry.reset();
+        
+        if (!p.second.empty())
+        {
+            // plain new goes through Bullet's aligned allocators
+            triangles.geometry.reset(new MeshPhysicsGeometry(p.first, p.second));
+            triangles.shape.reset(new btBvhTriangleMeshShape(triangles.geometry.get(), true));
+        }
+    }
+    
+    return triangles;
+}
+
+void VoxelPhysicsShape::calculateLocalInertia(btScalar mass, btVector3& inertia) const
+{
+    // static terrain only
+    assert(mass == 0);
+    
+    inertia.setValue(0, 0, 0);
+}
+
+void VoxelPhysicsShape::setLocalScaling(const btVector3& scaling)
+{
+    localScaling = scaling;
+}
\ No newline at end of file
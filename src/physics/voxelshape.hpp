@@ -0,0 +1,59 @@
+#pragma once
+
+#include "voxel/mesher.hpp"
+
+#include "btBulletCollisionCommon.h"
+
+namespace voxel
+{
+    class Grid;
+    class Region;
+}
+
+struct MeshPhysicsGeometry;
+
+// Static concave shape over grid cells; triangles are meshed per chunk on first query and cached until the chunk cells change
+class VoxelPhysicsShape: public btConcaveShape, noncopyable
+{
+public:
+    VoxelPhysicsShape(const voxel::Grid* grid, unique_ptr<voxel::Mesher> mesher);
+    ~VoxelPhysicsShape();
+    
+    void setMesher(unique_ptr<voxel::Mesher> mesher);
+    
+    // Marks cached triangles that depend on cells in the region as stale; call after grid edits
+    void invalidate(const voxel::Region& region);
+    
+    void getAabb(const btTransform& t, btVector3& aabbMin, btVector3& aabbMax) const override;
+    
+    void processAllTriangles(btTriangleCallback* callback, const btVector3& aabbMin, const btVector3& aabbMax) const override;
+    
+    void calculateLocalInertia(btScalar mass, btVector3& inertia) const override;
+    
+    void setLocalScaling(const btVector3& scaling) override;
+    const btVector3& getLocalScaling() const override { return localScaling; }
+    
+    const char* getName() const override { return "VoxelPhysicsShape"; }
+    
+private:
+    // Chunk triangles in grid space; chunks without triangles have no geometry
+    struct ChunkTriangles
+    {
+        unique_ptr<MeshPhysicsGeometry> geometry;
+        unique_ptr<btBvhTriangleMeshShape> shape;
+        
+        unsigned int lastQuery;
+        bool stale;
+    };
+    
+    ChunkTriangles& getChunkTriangles(const glm::i32vec3& id) const;
+    
+    const voxel::Grid* grid;
+    unique_ptr<voxel::Mesher> mesher;
+    
+    btVector3 localScaling;
+    
+    // queries are const for Bullet, so the cache is mutable
+    mutable unordered_map<glm::i32vec3, ChunkTriangles> chunks;
+    mutable unsigned int queryEpoch = 0;
+};
\ No newline at end of file
@@ -0,0 +1,179 @@
+#include "common.hpp"
+#include "ui/atlaslayout.hpp"
+
+namespace ui
+{
+    static unsigned long long wrapAround(unsigned long long start, unsigned int size, unsigned int alignment)
+    {
+        unsigned long long s0 = start / alignment;
+        unsigned long long s1 = (start + size - 1) / alignment;
+        
+        return (s0 == s1) ? start : s1 * alignment;
+    }
+
+    AtlasLayoutShelf::AtlasLayoutShelf(unsigned int atlasWidth, unsigned int atlasHeight)
+    : atlasWidth(atlasWidth)
+    , atlasHeight(atlasHeight)
+    , areaBegin(0)
+    , areaEnd(atlasHeight)
+    , lineBegin(0)
+    , lineEnd(0)
+    , position(0)
+    {
+    }
+
+    optional<pair<unsigned int, unsigned long long>> AtlasLayoutShelf::addRect(unsigned int width, unsigned int height)
+    {
+        unsigned int resultPosition = position;
+        unsigned long long resultLine = lineBegin;
+        
+        if (resultPosition + width > atlasWidth)
+        {
+            resultPosition = 0;
+            resultLine = lineEnd;
+        }
+        
+        resultLine = wrapAround(resultLine, height, atlasHeight);
+        
+        if (resultPosition + width <= atlasWidth && resultLine + height <= areaEnd)
+        {
+            position = resultPosition + width;
+            lineBegin = resultLine;
+            lineEnd = max(lineEnd, resultLine + height);
+            
+            return make_optional(make_pair(resultPosition, resultLine));
+        }
+        
+        return {};
+    }
+
+    optional<pair<unsigned long long, unsigned long long>> AtlasLayoutShelf::growFreeArea(unsigned int desiredHeight)
+    {
+        assert(areaBegin < areaEnd);
+        assert(lineBegin <= lineEnd);
+        assert(lineBegin >= areaBegin && lineEnd <= areaEnd);
+        assert(areaEnd - areaBegin <= atlasHeight);
+        
+        unsigned int freeHeight = areaEnd - lineEnd;
+        
+        if (freeHeight < desiredHeight)
+        {
+            unsigned int difference = desiredHeight - freeHeight;
+            
+            areaBegin += difference;
+            areaEnd += difference;
+            
+            // Move the layout state to make sure rectangles fit within the allowed area
+            lineBegin = max(lineBegin, areaBegin);
+            
+            return make_optional(make_pair(areaBegin - difference, areaBegin));
+        }
+        
+        return {};
+    }
+
+    AtlasLayoutSkyline::AtlasLayoutSkyline(unsigned int atlasWidth, unsigned int atlasHeight)
+    : atlasWidth(atlasWidth)
+    , atlasHeight(atlasHeight)
+    , areaBegin(0)
+    , areaEnd(atlasHeight)
+    {
+        skyline.push_back(make_pair(0, 0));
+    }
+
+    optional<pair<unsigned int, unsigned long long>> AtlasLayoutSkyline::addRect(unsigned int width, unsigned int height)
+    {
+        int bestindex = -1;
+        unsigned long long besty = 0;
+        unsigned int bestspan = 0;
+        
+        // Try to find a skyline fit without wrapping
+        for (unsigned int index = 0; index < skyline.size(); ++index)
+        {
+            auto fr = tryFit(index, width, height);
+            
+            if (fr && (bestindex < 0 || fr->first < besty))
+            {
+                bestindex = index;
+                besty = fr->first;
+                bestspan = fr->second;
+            }
+        }
+        
+        if (bestindex >= 0)
+        {
+            unsigned int x = skyline[bestindex].first;
+            
+            if (bestindex + bestspan < skyline.size())
+                skyline[bestindex + bestspan].first = x + width;
+            
+            skyline.erase(skyline.begin() + bestindex, skyline.begin() + bestindex + bestspan);
+            skyline.insert(skyline.begin() + bestindex, make_pair(x, besty + height));
+            
+            return make_optional(make_pair(x, besty));
+        }
+        
+        // Fail
+        return {};
+    }
+
+    optional<pair<unsigned long long, unsigned long long>> AtlasLayoutSkyline::growFreeArea(unsigned int desiredHeight)
+    {
+        unsigned long long lineEnd = 0;
+        
+        for (auto& s: skyline)
+            lineEnd = max(lineEnd, s.second);
+
+        assert(areaBegin < areaEnd);
+        assert(lineEnd <= areaEnd);
+        assert(areaEnd - areaBegin <= atlasHeight);
+     
+        unsigned int freeHeight = areaEnd - lineEnd;
+        
+        if (freeHeight < desiredHeight)
+        {
+            unsigned int difference = desiredHeight - freeHeight;
+            
+            areaBegin += difference;
+            areaEnd += difference;
+            
+            // Move the layout state to make sure rectangles fit within the allowed area
+            for (auto& s: skyline)
+                s.second = max(s.second, areaBegin);
+            
+            return make_optional(make_pair(areaBegin - difference, areaBegin));
+        }
+        
+        return {};
+    }
+
+    optional<pair<unsigned long long, unsigned int>> AtlasLayoutSkyline::tryFit(unsigned int index, unsigned int width, unsigned int height) const
+    {
+        if (skyline[index].first + width <= atlasWidth)
+        {
+            unsigned long long y = 0;
+            
+            for (unsigned int i = index; i < skyline.size(); ++i)
+            {
+                unsigned int segmentEnd = (i + 1 < skyline.size()) ? skyline[i + 1].first : atlasWidth;
+                unsigned int segmentWidth = segmentEnd - skyline[i].first;
+                
+                y = max(y, skyline[i].second);
+                
+                if (width <= segmentWidth)
+                {
+                    y = wrapAround(y, height, atlasHeight);
+                    
+                    if (y + height <= areaEnd)
+                        return make_optional(make_pair(y, (i - index) + (width == segmentWidth)));
+                    else
+                        return {};
+                }
+                
+                width -= segmentWidth;
+            }
+        }
+        
+        return {};
+    }
+}
\ No newline at end of file
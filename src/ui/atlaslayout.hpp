@@ -0,0 +1,49 @@
+#pragma once
+
+namespace ui
+{
+    // Rectangle packers for glyph atlases; y grows monotonically and wraps around the atlas height,
+    // growFreeArea returns the y range that has to be evicted to make room
+    class AtlasLayoutShelf
+    {
+    public:
+        AtlasLayoutShelf(unsigned int atlasWidth, unsigned int atlasHeight);
+        
+        optional<pair<unsigned int, unsigned long long>> addRect(unsigned int width, unsigned int height);
+        
+        optional<pair<unsigned long long, unsigned long long>> growFreeArea(unsigned int desiredHeight);
+    
+    private:
+        unsigned int atlasWidth;
+        unsigned int atlasHeight;
+        
+        unsigned long long areaBegin;
+        unsigned long long areaEnd;
+        
+        unsigned long long lineBegin;
+        unsigned long long lineEnd;
+        
+        unsigned int position;
+    };
+ 
+    class AtlasLayoutSkyline
+    {
+    public:
+        AtlasLayoutSkyline(unsigned int atlasWidth, unsigned int atlasHeight);
+        
+        optional<pair<unsigned int, unsigned long long>> addRect(unsigned int width, unsigned int height);
+        
+        optional<pair<unsigned long long, unsigned long long>> growFreeArea(unsigned int desiredHeight);
+    
+    private:
+        optional<pair<unsigned long long, unsigned int>> tryFit(unsigned int index, unsigned int width, unsigned int height) const;
+        
+        unsigned int atlasWidth;
+        unsigned int atlasHeight;
+        
+        unsigned long long areaBegin;
+        unsigned long long areaEnd;
+        
+        vector<pair<unsigned int, unsigned long long>> skyline;
+    };
+}
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 
+#include "ui/atlaslayout.hpp"
+
 class Texture;
 
 namespace ui
@@ -62,55 +64,12 @@ namespace ui
             size_t operator()(const GlyphKey& key) const;
         };
         
-        class LayoutShelf
-        {
-        public:
-            LayoutShelf(unsigned int atlasWidth, unsigned int atlasHeight);
-            
-            optional<pair<unsigned int, unsigned long long>> addRect(unsigned int width, unsigned int height);
-            
-            optional<pair<unsigned long long, unsigned long long>> growFreeArea(unsigned int desiredHeight);
-        
-        private:
-            unsigned int atlasWidth;
-            unsigned int atlasHeight;
-            
-            unsigned long long areaBegin;
-            unsigned long long areaEnd;
-            
-            unsigned long long lineBegin;
-            unsigned long long lineEnd;
-            
-            unsigned int position;
-        };
-     
-        class LayoutSkyline
-        {
-        public:
-            LayoutSkyline(unsigned int atlasWidth, unsigned int atlasHeight);
-            
-            optional<pair<unsigned int, unsigned long long>> addRect(unsigned int width, unsigned int height);
-            
-            optional<pair<unsigned long long, unsigned long long>> growFreeArea(unsigned int desiredHeight);
-        
-        private:
-            optional<pair<unsigned long long, unsigned int>> tryFit(unsigned int index, unsigned int width, unsigned int height) const;
-            
-            unsigned int atlasWidth;
-            unsigned int atlasHeight;
-            
-            unsigned long long areaBegin;
-            unsigned long long areaEnd;
-            
-            vector<pair<unsigned int, unsigned long long>> skyline;
-        };
-        
         unique_ptr<Texture> texture;
         
         unordered_map<GlyphKey, Font::GlyphBitmap, GlyphKeyHash> glyphs;
         multimap<unsigned long long, GlyphKey> glyphsY;
         
-        LayoutSkyline layout;
+        AtlasLayoutSkyline layout;
     };
 
     class FontLibrary
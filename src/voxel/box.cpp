@@ -0,0 +1,23 @@
+#include "common.hpp"
+#include "voxel/box.hpp"
+
+namespace voxel
+{
+    Region Region::intersect(const Region& other) const
+    {
+        glm::i32vec3 ibegin = glm::max(begin(), other.begin());
+        glm::i32vec3 iend = glm::min(end(), other.end());
+        
+        return Region(ibegin, glm::max(ibegin, iend));
+    }
+ 
+    Box::Box(unsigned int width, unsigned int height, unsigned int depth)
+    : width(width)
+    , height(height)
+    , depth(depth)
+    , slice(width * height)
+    , size(size_t(width) * height * depth)
+    {
+        data.reset(new unsigned char[size * 2]());
+    }
+}
\ No newline at end of file
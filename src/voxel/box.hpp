@@ -0,0 +1,139 @@
+#pragma once
+
+namespace voxel
+{
+    struct Cell
+    {
+        unsigned char occupancy;
+        unsigned char material;
+    };
+    
+    class Region
+    {
+    public:
+        Region(const glm::i32vec3& begin, const glm::i32vec3& end)
+        : begin_(begin)
+        , end_(end)
+        {
+            assert(begin.x <= end.x && begin.y <= end.y && begin.z <= end.z);
+        }
+        
+        Region(const glm::i32vec3& begin, unsigned int size)
+        : begin_(begin)
+        , end_(begin + int(size))
+        {
+        }
+        
+        const glm::i32vec3& begin() const { return begin_; }
+        const glm::i32vec3& end() const { return end_; }
+        
+        glm::i32vec3 size() const { return end_ - begin_; }
+ 
+        bool empty() const { return begin_.x == end_.x || begin_.y == end_.y || begin_.z == end_.z; }
+        
+        Region intersect(const Region& other) const;
+    
+    private:
+        glm::i32vec3 begin_;
+        glm::i32vec3 end_;
+    };
+    
+    // View of one byte plane of a box; cells of a plane are stored in x-major order
+    template <typename T> class BoxPlane
+    {
+    public:
+        BoxPlane(T* data, unsigned int width, unsigned int height, unsigned int depth)
+        : data(data)
+        , width(width)
+        , height(height)
+        , depth(depth)
+        {
+        }
+        
+        T& operator()(unsigned int x, unsigned int y, unsigned int z) const
+        {
+            assert(x < width && y < height && z < depth);
+            return data[x + width * (y + height * z)];
+        }
+        
+        // Returns contiguous values starting at (x, y, z); count is clamped to the end of the row
+        T* getRow(unsigned int x, unsigned int y, unsigned int z, unsigned int& count) const
+        {
+            assert(x < width && y < height && z < depth);
+            count = min(count, width - x);
+            return &data[x + width * (y + height * z)];
+        }
+        
+        T* getData() const { return data; }
+        
+        unsigned int getWidth() const { return width; }
+        unsigned int getHeight() const { return height; }
+        unsigned int getDepth() const { return depth; }
+        
+    private:
+        T* data;
+        
+        unsigned int width;
+        unsigned int height;
+        unsigned int depth;
+    };
+    
+    // Cells stored as separate occupancy and material planes, so that sweeps over one of them read contiguous bytes
+    class Box
+    {
+    public:
+        Box(unsigned int width, unsigned int height, unsigned int depth);
+        
+        Cell operator()(unsigned int x, unsigned int y, unsigned int z) const
+        {
+            assert(x < width && y < height && z < depth);
+            
+            size_t index = x + width * y + slice * z;
+            
+            return Cell { data[index], data[size + index] };
+        }
+        
+        unsigned char getOccupancy(unsigned int x, unsigned int y, unsigned int z) const
+        {
+            assert(x < width && y < height && z < depth);
+            
+            return data[x + width * y + slice * z];
+        }
+        
+        void set(unsigned int x, unsigned int y, unsigned int z, const Cell& cell)
+        {
+            assert(x < width && y < height && z < depth);
+            
+            size_t index = x + width * y + slice * z;
+            
+            data[index] = cell.occupancy;
+            data[size + index] = cell.material;
+        }
+        
+        BoxPlane<unsigned char> getOccupancy() { return BoxPlane<unsigned char>(data.get(), width, height, depth); }
+        BoxPlane<const unsigned char> getOccupancy() const { return BoxPlane<const unsigned char>(data.get(), width, height, depth); }
+        
+        BoxPlane<unsigned char> getMaterial() { return BoxPlane<unsigned char>(data.get() + size, width, height, depth); }
+        BoxPlane<const unsigned char> getMaterial() const { return BoxPlane<const unsigned char>(data.get() + size, width, height, depth); }
+        
+        // Returns contiguous occupancy values starting at (x, y, z); count is clamped to the end of the row
+        const unsigned char* getOccupancyRow(unsigned int x, unsigned int y, unsigned int z, unsigned int& count) const
+        {
+            return getOccupancy().getRow(x, y, z, count);
+        }
+        
+        unsigned int getWidth() const { return width; }
+        unsigned int getHeight() const { return height; }
+        unsigned int getDepth() const { return depth; }
+        
+    private:
+        unsigned int width;
+        unsigned int height;
+        unsigned int depth;
+        unsigned int slice;
+        size_t size;
+        
+        // occupancy plane followed by material plane
+        unique_ptr<unsigned char[]> data;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "common.hpp"
+#include "voxel/cellplanes.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace voxel
+{
+    static_assert(sizeof(Cell) == 2, "SIMD plane conversion assumes 2-byte cells");
+    
+    void splitCells(unsigned char* occupancy, unsigned char* material, const Cell* cells, size_t count)
+    {
+        size_t i = 0;
+        
+    #if defined(__AVX2__)
+        __m256i lowMask = _mm256_set1_epi16(0xff);
+        
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256i c0 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i));
+            __m256i c1 = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(cells + i + 16));
+            
+            // packus interleaves 128-bit lanes; restore cell order
+            __m256i o = _mm256_packus_epi16(_mm256_and_si256(c0, lowMask), _mm256_and_si256(c1, lowMask));
+            __m256i m = _mm256_packus_epi16(_mm256_srli_epi16(c0, 8), _mm256_srli_epi16(c1, 8));
+            
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(occupancy + i), _mm256_permute4x64_epi64(o, 0xd8));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(material + i), _mm256_permute4x64_epi64(m, 0xd8));
+        }
+    #elif defined(__SSE2__)
+        __m128i lowMask = _mm_set1_epi16(0xff);
+        
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i c0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i));
+            __m128i c1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(cells + i + 8));
+            
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(occupancy + i), _mm_packus_epi16(_mm_and_si128(c0, lowMask), _mm_and_si128(c1, lowMask)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(material + i), _mm_packus_epi16(_mm_srli_epi16(c0, 8), _mm_srli_epi16(c1, 8)));
+        }
+    #endif
+        
+        for (; i < count; ++i)
+        {
+            occupancy[i] = cells[i].occupancy;
+            material[i] = cells[i].material;
+        }
+    }
+    
+    void interleaveCells(Cell* cells, const unsigned char* occupancy, const unsigned char* material, size_t count)
+    {
+        size_t i = 0;
+        
+    #if defined(__AVX2__)
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256i o = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(occupancy + i));
+            __m256i m = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(material + i));
+            
+            // unpack works within 128-bit lanes; reorder the halves to restore cell order
+            __m256i lo = _mm256_unpacklo_epi8(o, m);
+            __m256i hi = _mm256_unpackhi_epi8(o, m);
+            
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(cells + i), _mm256_permute2x128_si256(lo, hi, 0x20));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(cells + i + 16), _mm256_permute2x128_si256(lo, hi, 0x31));
+        }
+    #elif defined(__SSE2__)
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i o = _mm_loadu_si128(reinterpret_cast<const __m128i*>(occupancy + i));
+            __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(material + i));
+            
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(cells + i), _mm_unpacklo_epi8(o, m));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(cells + i + 8), _mm_unpackhi_epi8(o, m));
+        }
+    #endif
+        
+        for (; i < count; ++i)
+            cells[i] = Cell { occupancy[i], material[i] };
+    }
+}
\ No newline at end of file
@@ -0,0 +1,10 @@
+#pragma once
+
+#include "voxel/box.hpp"
+
+namespace voxel
+{
+    // Converts interleaved cells to separate occupancy and material planes and back
+    void splitCells(unsigned char* occupancy, unsigned char* material, const Cell* cells, size_t count);
+    void interleaveCells(Cell* cells, const unsigned char* occupancy, const unsigned char* material, size_t count);
+}
\ No newline at end of file
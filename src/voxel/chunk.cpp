@@ -0,0 +1,538 @@
+#include "common.hpp"
+#include "voxel/chunk.hpp"
+
+#include "voxel/cellplanes.hpp"
+
+namespace voxel
+{
+    // writes search the palette linearly, so chunks with more distinct values stay dense
+    const unsigned int kPaletteWriteSizeMax = 16;
+    
+    static unsigned int getCellKey(const Cell& cell)
+    {
+        return cell.occupancy | (cell.material << 8);
+    }
+    
+    static unsigned int getCellIndex(unsigned int x, unsigned int y, unsigned int z)
+    {
+        assert(x < kChunkSize && y < kChunkSize && z < kChunkSize);
+        
+        return x + kChunkSize * (y + kChunkSize * z);
+    }
+    
+    // calls f(index, start, run) for contiguous parts of a dense storage row, where start is the offset into the row;
+    // bricked rows are split at brick boundaries
+    template <typename F> static void forEachDenseRun(Chunk::Layout layout, unsigned int x, unsigned int y, unsigned int z, unsigned int count, F f)
+    {
+        if (layout == Chunk::Layout_Linear)
+        {
+            f(getCellIndex(x, y, z), 0, count);
+            return;
+        }
+        
+        for (unsigned int start = 0; start < count; )
+        {
+            unsigned int run = min(count - start, kChunkBrickSize - ((x + start) & (kChunkBrickSize - 1)));
+            
+            f(Chunk::getBrickedIndex(x + start, y, z), start, run);
+            
+            start += run;
+        }
+    }
+    
+    // rows that repeat one value are common, and are compared without branches
+    static bool isUniformRow(const unsigned char* occupancy, const unsigned char* material, const Cell& cell)
+    {
+        unsigned char diff = 0;
+        
+        for (unsigned int i = 0; i < kChunkSize; ++i)
+            diff |= (occupancy[i] ^ cell.occupancy) | (material[i] ^ cell.material);
+        
+        return diff == 0;
+    }
+    
+    static unsigned int getPaletteBitsLog2(size_t size)
+    {
+        unsigned int result = 0;
+        
+        while ((1u << (1 << result)) < size)
+            result++;
+        
+        return result;
+    }
+    
+    Chunk::Chunk()
+    : storage(Storage_Uniform)
+    , layout(Layout_Linear)
+    , uniform(Cell { 0, 0 })
+    , paletteBitsLog2(0)
+    , optimized(true)
+    {
+    }
+    
+    Chunk::Chunk(const Cell& cell)
+    : storage(Storage_Uniform)
+    , layout(Layout_Linear)
+    , uniform(cell)
+    , paletteBitsLog2(0)
+    , optimized(true)
+    {
+    }
+    
+    Cell Chunk::get(unsigned int x, unsigned int y, unsigned int z) const
+    {
+        unsigned int index = getCellIndex(x, y, z);
+        
+        switch (storage)
+        {
+        case Storage_Uniform:
+            return uniform;
+            
+        case Storage_Palette:
+            return palette[getPaletteIndex(index)];
+            
+        case Storage_Dense:
+            return getDenseCell(index);
+        }
+        
+        assert(false);
+        return uniform;
+    }
+    
+    unsigned char Chunk::getOccupancy(unsigned int x, unsigned int y, unsigned int z) const
+    {
+        unsigned int index = getCellIndex(x, y, z);
+        
+        switch (storage)
+        {
+        case Storage_Uniform:
+            return uniform.occupancy;
+            
+        case Storage_Palette:
+            return palette[getPaletteIndex(index)].occupancy;
+            
+        case Storage_Dense:
+            return dense[getDenseIndex(index)];
+        }
+        
+        assert(false);
+        return uniform.occupancy;
+    }
+    
+    void Chunk::read(Cell* result, unsigned int x, unsigned int y, unsigned int z, unsigned int count) const
+    {
+        assert(x + count <= kChunkSize);
+        
+        unsigned int offset = getCellIndex(x, y, z);
+        
+        switch (storage)
+        {
+        case Storage_Uniform:
+            fill(result, result + count, uniform);
+            break;
+            
+        case Storage_Palette:
+            for (unsigned int i = 0; i < count; ++i)
+                result[i] = palette[getPaletteIndex(offset + i)];
+            break;
+            
+        case Storage_Dense:
+            forEachDenseRun(layout, x, y, z, count, [&](unsigned int index, unsigned int start, unsigned int run) {
+                interleaveCells(result + start, &dense[index], &dense[kChunkCells + index], run);
+            });
+            break;
+        }
+    }
+    
+    void Chunk::read(unsigned char* occupancy, unsigned char* material, unsigned int x, unsigned int y, unsigned int z, unsigned int count) const
+    {
+        assert(x + count <= kChunkSize);
+        
+        switch (storage)
+        {
+        case Storage_Uniform:
+            if (occupancy)
+                memset(occupancy, uniform.occupancy, count);
+            if (material)
+                memset(material, uniform.material, count);
+            break;
+            
+        case Storage_Palette:
+            for (unsigned int i = 0, offset = getCellIndex(x, y, z); i < count; ++i)
+            {
+                const Cell& cell = palette[getPaletteIndex(offset + i)];
+                
+                if (occupancy)
+                    occupancy[i] = cell.occupancy;
+                if (material)
+                    material[i] = cell.material;
+            }
+            break;
+            
+        case Storage_Dense:
+            forEachDenseRun(layout, x, y, z, count, [&](unsigned int index, unsigned int start, unsigned int run) {
+                if (occupancy)
+                    memcpy(occupancy + start, &dense[index], run);
+                if (material)
+                    memcpy(material + start, &dense[kChunkCells + index], run);
+            });
+            break;
+        }
+    }
+    
+    void Chunk::write(const Cell* data, unsigned int x, unsigned int y, unsigned int z, unsigned int count)
+    {
+        assert(x + count <= kChunkSize);
+        
+        unsigned int offset = getCellIndex(x, y, z);
+        
+        if (storage == Storage_Uniform)
+        {
+            unsigned int key = getCellKey(uniform);
+            
+            if (all_of(data, data + count, [&](const Cell& c) { return getCellKey(c) == key; }))
+                return;
+            
+            expandToPalette();
+        }
+        
+        optimized = false;
+        
+        if (storage == Storage_Palette && writePalette(data, offset, count))
+            return;
+        
+        if (storage != Storage_Dense)
+            expandToDense();
+        
+        forEachDenseRun(layout, x, y, z, count, [&](unsigned int index, unsigned int start, unsigned int run) {
+            splitCells(&dense[index], &dense[kChunkCells + index], data + start, run);
+        });
+    }
+    
+    void Chunk::write(const unsigned char* occupancy, const unsigned char* material, unsigned int x, unsigned int y, unsigned int z, unsigned int count)
+    {
+        assert(x + count <= kChunkSize);
+        
+        // uniform and palette writes compare whole cells
+        if (storage != Storage_Dense)
+        {
+            Cell cells[kChunkSize];
+            interleaveCells(cells, occupancy, material, count);
+            
+            write(cells, x, y, z, count);
+            return;
+        }
+        
+        optimized = false;
+        
+        forEachDenseRun(layout, x, y, z, count, [&](unsigned int index, unsigned int start, unsigned int run) {
+            memcpy(&dense[index], occupancy + start, run);
+            memcpy(&dense[kChunkCells + index], material + start, run);
+        });
+    }
+    
+    void Chunk::optimize()
+    {
+        if (optimized)
+            return;
+        
+        optimized = true;
+        
+        if (storage == Storage_Palette)
+        {
+            // palette use is counted on write, so only palettes that lost entries need a pass over the cells
+            unsigned int used = count_if(paletteCounts.begin(), paletteCounts.end(), [](unsigned int count) { return count != 0; });
+            
+            if (used == 1)
+                setUniform(palette[find_if(paletteCounts.begin(), paletteCounts.end(), [](unsigned int count) { return count != 0; }) - paletteCounts.begin()]);
+            else if (used < palette.size())
+                compactPalette();
+        }
+        else if (storage == Storage_Dense)
+        {
+            // the scan stops as soon as the chunk has too many distinct values for a palette;
+            // distinct values do not depend on the cell order, so the planes are scanned in storage order
+            Cell last = Cell { dense[0], dense[kChunkCells] };
+            
+            vector<Cell> newPalette(1, last);
+            
+            for (unsigned int row = 0; row < kChunkCells; row += kChunkSize)
+            {
+                if (isUniformRow(&dense[row], &dense[kChunkCells + row], last))
+                    continue;
+                
+                for (unsigned int i = row; i < row + kChunkSize; ++i)
+                {
+                    Cell cell = Cell { dense[i], dense[kChunkCells + i] };
+                    unsigned int key = getCellKey(cell);
+                    
+                    if (key == getCellKey(last))
+                        continue;
+                    
+                    last = cell;
+                    
+                    if (any_of(newPalette.begin(), newPalette.end(), [&](const Cell& c) { return getCellKey(c) == key; }))
+                        continue;
+                    
+                    if (newPalette.size() == kPaletteWriteSizeMax)
+                        return;
+                    
+                    newPalette.push_back(cell);
+                }
+            }
+            
+            if (newPalette.size() == 1)
+            {
+                setUniform(newPalette[0]);
+                return;
+            }
+            
+            unsigned int newBitsLog2 = getPaletteBitsLog2(newPalette.size());
+            
+            unique_ptr<unsigned int[]> newData(new unsigned int[(kChunkCells << newBitsLog2) / 32]());
+            unsigned int newCounts[kPaletteWriteSizeMax] = {};
+            
+            unsigned int cellsPerWord = 32 >> newBitsLog2;
+            
+            // replicates an index to all cells of a word
+            unsigned int wordFill = ~0u / ((1u << (1 << newBitsLog2)) - 1);
+            
+            unsigned int index = 0;
+            
+            for (unsigned int z = 0; z < kChunkSize; ++z)
+                for (unsigned int y = 0; y < kChunkSize; ++y)
+                {
+                    unsigned char occupancy[kChunkSize];
+                    unsigned char material[kChunkSize];
+                    
+                    read(occupancy, material, 0, y, z, kChunkSize);
+                    
+                    unsigned int* words = &newData[getCellIndex(0, y, z) / cellsPerWord];
+                    
+                    if (isUniformRow(occupancy, material, newPalette[index]))
+                    {
+                        fill(words, words + kChunkSize / cellsPerWord, index * wordFill);
+                        newCounts[index] += kChunkSize;
+                        continue;
+                    }
+                    
+                    for (unsigned int i = 0; i < kChunkSize; ++i)
+                    {
+                        unsigned int key = getCellKey(Cell { occupancy[i], material[i] });
+                        
+                        if (getCellKey(newPalette[index]) != key)
+                            index = find_if(newPalette.begin(), newPalette.end(), [&](const Cell& c) { return getCellKey(c) == key; }) - newPalette.begin();
+                        
+                        words[i / cellsPerWord] |= index << ((i % cellsPerWord) << newBitsLog2);
+                        newCounts[index]++;
+                    }
+                }
+            
+            storage = Storage_Palette;
+            palette = move(newPalette);
+            paletteCounts.assign(newCounts, newCounts + palette.size());
+            paletteBitsLog2 = newBitsLog2;
+            paletteData = move(newData);
+            dense.reset();
+        }
+    }
+    
+    unsigned char* Chunk::resetDense()
+    {
+        if (storage != Storage_Dense)
+        {
+            // contents are replaced, so the old storage is dropped instead of expanded
+            setUniform(Cell { 0, 0 });
+            
+            dense.reset(new unsigned char[kChunkCells * 2]);
+            storage = Storage_Dense;
+        }
+        
+        optimized = false;
+        
+        return dense.get();
+    }
+    
+    void Chunk::setLayout(Layout newLayout)
+    {
+        if (layout == newLayout)
+            return;
+        
+        if (dense)
+        {
+            unique_ptr<Cell[]> cells(new Cell[kChunkCells]);
+            
+            // rows are read in the old layout and written back in the new one
+            for (unsigned int z = 0; z < kChunkSize; ++z)
+                for (unsigned int y = 0; y < kChunkSize; ++y)
+                    read(&cells[getCellIndex(0, y, z)], 0, y, z, kChunkSize);
+            
+            bool wasOptimized = optimized;
+            
+            layout = newLayout;
+            
+            for (unsigned int z = 0; z < kChunkSize; ++z)
+                for (unsigned int y = 0; y < kChunkSize; ++y)
+                    write(&cells[getCellIndex(0, y, z)], 0, y, z, kChunkSize);
+            
+            // the contents are unchanged
+            optimized = wasOptimized;
+        }
+        
+        layout = newLayout;
+    }
+    
+    size_t Chunk::getMemoryUsage() const
+    {
+        size_t result = sizeof(Chunk);
+        
+        if (paletteData)
+            result += palette.capacity() * sizeof(Cell) + (kChunkCells << paletteBitsLog2) / 8;
+        
+        if (dense)
+            result += kChunkCells * 2;
+        
+        return result;
+    }
+    
+    void Chunk::compactPalette()
+    {
+        assert(storage == Storage_Palette);
+        
+        unsigned int remap[kPaletteWriteSizeMax];
+        
+        vector<Cell> newPalette;
+        vector<unsigned int> newCounts;
+        
+        for (unsigned int i = 0; i < palette.size(); ++i)
+            if (paletteCounts[i] != 0)
+            {
+                remap[i] = newPalette.size();
+                newPalette.push_back(palette[i]);
+                newCounts.push_back(paletteCounts[i]);
+            }
+        
+        unsigned int newBitsLog2 = getPaletteBitsLog2(newPalette.size());
+        
+        unique_ptr<unsigned int[]> newData(new unsigned int[(kChunkCells << newBitsLog2) / 32]());
+        
+        for (unsigned int i = 0; i < kChunkCells; ++i)
+        {
+            unsigned int bit = i << newBitsLog2;
+            
+            newData[bit / 32] |= remap[getPaletteIndex(i)] << (bit % 32);
+        }
+        
+        palette = move(newPalette);
+        paletteCounts = move(newCounts);
+        paletteBitsLog2 = newBitsLog2;
+        paletteData = move(newData);
+    }
+    
+    bool Chunk::writePalette(const Cell* data, unsigned int offset, unsigned int count)
+    {
+        assert(storage == Storage_Palette && count <= kChunkSize);
+        
+        if (palette.size() > kPaletteWriteSizeMax)
+            return false;
+        
+        unsigned char indices[kChunkSize];
+        
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            unsigned int key = getCellKey(data[i]);
+            unsigned int index = 0;
+            
+            while (index < palette.size() && getCellKey(palette[index]) != key)
+                index++;
+            
+            if (index == palette.size())
+            {
+                if (palette.size() == kPaletteWriteSizeMax)
+                    return false;
+                
+                palette.push_back(data[i]);
+                paletteCounts.push_back(0);
+            }
+            
+            indices[i] = index;
+        }
+        
+        unsigned int newBitsLog2 = getPaletteBitsLog2(palette.size());
+        
+        if (newBitsLog2 != paletteBitsLog2)
+        {
+            unique_ptr<unsigned int[]> newData(new unsigned int[(kChunkCells << newBitsLog2) / 32]());
+            
+            for (unsigned int i = 0; i < kChunkCells; ++i)
+            {
+                unsigned int bit = i << newBitsLog2;
+                
+                newData[bit / 32] |= getPaletteIndex(i) << (bit % 32);
+            }
+            
+            paletteBitsLog2 = newBitsLog2;
+            paletteData = move(newData);
+        }
+        
+        for (unsigned int i = 0; i < count; ++i)
+        {
+            paletteCounts[getPaletteIndex(offset + i)]--;
+            paletteCounts[indices[i]]++;
+            
+            setPaletteIndex(offset + i, indices[i]);
+        }
+        
+        return true;
+    }
+    
+    void Chunk::setUniform(const Cell& cell)
+    {
+        storage = Storage_Uniform;
+        uniform = cell;
+        
+        palette.clear();
+        palette.shrink_to_fit();
+        paletteCounts.clear();
+        paletteCounts.shrink_to_fit();
+        paletteBitsLog2 = 0;
+        paletteData.reset();
+        dense.reset();
+    }
+    
+    void Chunk::expandToPalette()
+    {
+        assert(storage == Storage_Uniform);
+        
+        // single entry palette with a 1-bit index for the current uniform value
+        storage = Storage_Palette;
+        palette.assign(1, uniform);
+        paletteCounts.assign(1, kChunkCells);
+        paletteBitsLog2 = 0;
+        paletteData.reset(new unsigned int[kChunkCells / 32]());
+    }
+    
+    void Chunk::expandToDense()
+    {
+        assert(storage != Storage_Dense);
+        
+        dense.reset(new unsigned char[kChunkCells * 2]);
+        
+        for (unsigned int i = 0; i < kChunkCells; ++i)
+        {
+            const Cell& cell = (storage == Storage_Uniform) ? uniform : palette[getPaletteIndex(i)];
+            unsigned int index = getDenseIndex(i);
+            
+            dense[index] = cell.occupancy;
+            dense[kChunkCells + index] = cell.material;
+        }
+        
+        storage = Storage_Dense;
+        palette.clear();
+        palette.shrink_to_fit();
+        paletteCounts.clear();
+        paletteCounts.shrink_to_fit();
+        paletteBitsLog2 = 0;
+        paletteData.reset();
+    }
+}
\ No newline at end of file
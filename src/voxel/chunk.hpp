@@ -0,0 +1,134 @@
+#pragma once
+
+#include "voxel/box.hpp"
+
+namespace voxel
+{
+    const unsigned int kChunkSizeLog2 = 5;
+    const unsigned int kChunkSize = 1 << kChunkSizeLog2;
+    const unsigned int kChunkCells = kChunkSize * kChunkSize * kChunkSize;
+    
+    const unsigned int kChunkBrickSizeLog2 = 2;
+    const unsigned int kChunkBrickSize = 1 << kChunkBrickSizeLog2;
+    
+    // Chunk of kChunkSize^3 cells; storage is uniform, paletted or dense, depending on contents
+    class Chunk
+    {
+    public:
+        // Cell order of dense storage; bricked chunks keep kChunkBrickSize^3 bricks contiguous,
+        // so that neighborhood lookups touch fewer cache lines at the cost of shorter contiguous rows
+        enum Layout
+        {
+            Layout_Linear,
+            Layout_Bricked
+        };
+        
+        static unsigned int getBrickedIndex(unsigned int x, unsigned int y, unsigned int z)
+        {
+            const unsigned int bricks = kChunkSizeLog2 - kChunkBrickSizeLog2;
+            const unsigned int mask = kChunkBrickSize - 1;
+            
+            unsigned int brick = (x >> kChunkBrickSizeLog2) | ((y >> kChunkBrickSizeLog2) << bricks) | ((z >> kChunkBrickSizeLog2) << (bricks * 2));
+            
+            return (brick << (kChunkBrickSizeLog2 * 3)) | (x & mask) | ((y & mask) << kChunkBrickSizeLog2) | ((z & mask) << (kChunkBrickSizeLog2 * 2));
+        }
+        
+        Chunk();
+        explicit Chunk(const Cell& cell);
+        
+        Cell get(unsigned int x, unsigned int y, unsigned int z) const;
+        unsigned char getOccupancy(unsigned int x, unsigned int y, unsigned int z) const;
+        
+        void read(Cell* result, unsigned int x, unsigned int y, unsigned int z, unsigned int count) const;
+        void write(const Cell* data, unsigned int x, unsigned int y, unsigned int z, unsigned int count);
+        
+        // Plane variants of row access; either target plane may be null when reading
+        void read(unsigned char* occupancy, unsigned char* material, unsigned int x, unsigned int y, unsigned int z, unsigned int count) const;
+        void write(const unsigned char* occupancy, const unsigned char* material, unsigned int x, unsigned int y, unsigned int z, unsigned int count);
+        
+        // Converts storage to the most compact representation; call after a batch of writes.
+        // Chunks with more than a few distinct values stay dense, and chunks without writes since the last call are skipped
+        void optimize();
+        
+        bool isUniform() const { return storage == Storage_Uniform; }
+        const Cell& getUniformCell() const { assert(storage == Storage_Uniform); return uniform; }
+        
+        // Returns planes in layout order for dense chunks, nullptr otherwise
+        const unsigned char* getOccupancyData() const { return dense ? dense.get() : nullptr; }
+        const unsigned char* getMaterialData() const { return dense ? dense.get() + kChunkCells : nullptr; }
+        
+        // Switches to dense storage with undefined contents and returns both planes in layout order for bulk fills;
+        // call optimize() once the planes are filled
+        unsigned char* resetDense();
+        
+        // Changes the order of dense storage; the layout is kept when storage changes
+        void setLayout(Layout layout);
+        Layout getLayout() const { return layout; }
+        
+        size_t getMemoryUsage() const;
+        
+    private:
+        enum Storage
+        {
+            Storage_Uniform,
+            Storage_Palette,
+            Storage_Dense
+        };
+        
+        unsigned int getPaletteIndex(unsigned int index) const
+        {
+            unsigned int bit = index << paletteBitsLog2;
+            
+            return (paletteData[bit / 32] >> (bit % 32)) & ((1 << (1 << paletteBitsLog2)) - 1);
+        }
+        
+        void setPaletteIndex(unsigned int index, unsigned int value)
+        {
+            unsigned int bit = index << paletteBitsLog2;
+            unsigned int mask = (1 << (1 << paletteBitsLog2)) - 1;
+            
+            paletteData[bit / 32] = (paletteData[bit / 32] & ~(mask << (bit % 32))) | (value << (bit % 32));
+        }
+        
+        unsigned int getDenseIndex(unsigned int x, unsigned int y, unsigned int z) const
+        {
+            return layout == Layout_Bricked ? getBrickedIndex(x, y, z) : x + kChunkSize * (y + kChunkSize * z);
+        }
+        
+        unsigned int getDenseIndex(unsigned int index) const
+        {
+            const unsigned int mask = kChunkSize - 1;
+            
+            return layout == Layout_Bricked ? getBrickedIndex(index & mask, (index >> kChunkSizeLog2) & mask, index >> (kChunkSizeLog2 * 2)) : index;
+        }
+        
+        Cell getDenseCell(unsigned int index) const
+        {
+            unsigned int i = getDenseIndex(index);
+            
+            return Cell { dense[i], dense[kChunkCells + i] };
+        }
+        
+        bool writePalette(const Cell* data, unsigned int offset, unsigned int count);
+        void compactPalette();
+        
+        void setUniform(const Cell& cell);
+        void expandToPalette();
+        void expandToDense();
+        
+        Storage storage;
+        Layout layout;
+        
+        Cell uniform;
+        
+        vector<Cell> palette;
+        vector<unsigned int> paletteCounts;
+        unsigned int paletteBitsLog2;
+        unique_ptr<unsigned int[]> paletteData;
+        
+        // occupancy plane followed by material plane
+        unique_ptr<unsigned char[]> dense;
+        
+        bool optimized;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "common.hpp"
+#include "voxel/chunkcodec.hpp"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace voxel
+{
+    // shorter runs are cheaper to keep in a literal
+    const size_t kCodecRunMin = 3;
+    
+    // most tokens are shorter than a few blocks, so the decoder writes whole blocks past the token end when the buffers have room;
+    // the next token overwrites the excess, and longer tokens are faster with memcpy and memset
+    const size_t kCodecBlockSize = 16;
+    const size_t kCodecBlockTokenMax = kCodecBlockSize * 4;
+    
+    static void writeVarint(vector<unsigned char>& result, size_t value)
+    {
+        while (value >= 0x80)
+        {
+            result.push_back(static_cast<unsigned char>(value | 0x80));
+            value >>= 7;
+        }
+        
+        result.push_back(static_cast<unsigned char>(value));
+    }
+    
+    static bool readVarint(size_t& value, const unsigned char*& data, const unsigned char* end)
+    {
+        value = 0;
+        
+        for (unsigned int shift = 0; data < end && shift < 64; shift += 7)
+        {
+            unsigned char byte = *data++;
+            
+            value |= size_t(byte & 0x7f) << shift;
+            
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        
+        return false;
+    }
+    
+    // Tokens are a varint (length - 1) * 2 + literal followed by one repeated byte or by length literal bytes
+    static void encodePlane(vector<unsigned char>& result, const unsigned char* plane, size_t count)
+    {
+        size_t literal = 0;
+        
+        for (size_t i = 0; i < count; )
+        {
+            size_t run = 1;
+            
+            while (i + run < count && plane[i + run] == plane[i])
+                run++;
+            
+            if (run < kCodecRunMin && i + run < count)
+            {
+                i += run;
+                continue;
+            }
+            
+            // short runs at the end are folded into the pending literal
+            size_t literalEnd = (run < kCodecRunMin) ? i + run : i;
+            
+            if (literalEnd > literal)
+            {
+                writeVarint(result, (literalEnd - literal - 1) * 2 + 1);
+                result.insert(result.end(), plane + literal, plane + literalEnd);
+            }
+            
+            if (run >= kCodecRunMin)
+            {
+                writeVarint(result, (run - 1) * 2);
+                result.push_back(plane[i]);
+            }
+            
+            i += run;
+            literal = i;
+        }
+    }
+    
+    static void copyBlocks(unsigned char* dest, const unsigned char* source, size_t count)
+    {
+    #if defined(__SSE2__)
+        for (size_t i = 0; i < count; i += kCodecBlockSize)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)));
+    #else
+        memcpy(dest, source, count);
+    #endif
+    }
+    
+    static void fillBlocks(unsigned char* dest, unsigned char value, size_t count)
+    {
+    #if defined(__SSE2__)
+        __m128i v = _mm_set1_epi8(static_cast<char>(value));
+        
+        for (size_t i = 0; i < count; i += kCodecBlockSize)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dest + i), v);
+    #else
+        memset(dest, value, count);
+    #endif
+    }
+    
+    static bool decodePlane(unsigned char* plane, size_t count, const unsigned char*& data, const unsigned char* end)
+    {
+        for (size_t i = 0; i < count; )
+        {
+            size_t token;
+            
+            if (data < end && *data < 0x80)
+                token = *data++;
+            else if (!readVarint(token, data, end))
+                return false;
+            
+            size_t length = (token >> 1) + 1;
+            
+            if (length > count - i)
+                return false;
+            
+            size_t blocks = (length + kCodecBlockSize - 1) & ~(kCodecBlockSize - 1);
+            
+            if (token & 1)
+            {
+                if (size_t(end - data) < length)
+                    return false;
+                
+                if (length <= kCodecBlockTokenMax && blocks <= count - i && blocks <= size_t(end - data))
+                    copyBlocks(plane + i, data, blocks);
+                else
+                    memcpy(plane + i, data, length);
+                
+                data += length;
+            }
+            else
+            {
+                if (data == end)
+                    return false;
+                
+                if (length <= kCodecBlockTokenMax && blocks <= count - i)
+                    fillBlocks(plane + i, *data, blocks);
+                else
+                    memset(plane + i, *data, length);
+                
+                data++;
+            }
+            
+            i += length;
+        }
+        
+        return true;
+    }
+    
+    // Reads a plane that is a single run, as encodePlane writes for uniform planes
+    static bool decodeUniformPlane(unsigned char& value, size_t count, const unsigned char*& data, const unsigned char* end)
+    {
+        size_t token;
+        
+        if (!readVarint(token, data, end) || token != (count - 1) * 2 || data == end)
+            return false;
+        
+        value = *data++;
+        
+        return true;
+    }
+    
+    void encodePlanes(vector<unsigned char>& result, const unsigned char* occupancy, const unsigned char* material, size_t count)
+    {
+        result.clear();
+        
+        encodePlane(result, occupancy, count);
+        encodePlane(result, material, count);
+    }
+    
+    bool decodePlanes(unsigned char* occupancy, unsigned char* material, size_t count, const unsigned char* data, size_t size)
+    {
+        const unsigned char* end = data + size;
+        
+        return decodePlane(occupancy, count, data, end) && decodePlane(material, count, data, end) && data == end;
+    }
+    
+    void encodeChunk(vector<unsigned char>& result, const Chunk& chunk)
+    {
+        // records are in x-major order regardless of the chunk layout
+        if (chunk.getOccupancyData() && chunk.getLayout() == Chunk::Layout_Linear)
+        {
+            encodePlanes(result, chunk.getOccupancyData(), chunk.getMaterialData(), kChunkCells);
+            return;
+        }
+        
+        unique_ptr<unsigned char[]> planes(new unsigned char[kChunkCells * 2]);
+        
+        for (unsigned int z = 0; z < kChunkSize; ++z)
+            for (unsigned int y = 0; y < kChunkSize; ++y)
+            {
+                unsigned int offset = kChunkSize * (y + kChunkSize * z);
+                
+                chunk.read(&planes[offset], &planes[kChunkCells + offset], 0, y, z, kChunkSize);
+            }
+        
+        encodePlanes(result, planes.get(), planes.get() + kChunkCells, kChunkCells);
+    }
+    
+    bool decodeChunk(Chunk& chunk, const unsigned char* data, size_t size)
+    {
+        const unsigned char* end = data + size;
+        const unsigned char* uniformData = data;
+        
+        Cell cell;
+        
+        if (decodeUniformPlane(cell.occupancy, kChunkCells, uniformData, end) && decodeUniformPlane(cell.material, kChunkCells, uniformData, end) && uniformData == end)
+        {
+            chunk = Chunk(cell);
+            return true;
+        }
+        
+        // a new chunk is linear, so records decode straight into its planes
+        chunk = Chunk();
+        
+        unsigned char* planes = chunk.resetDense();
+        
+        if (!decodePlanes(planes, planes + kChunkCells, kChunkCells, data, size))
+        {
+            chunk = Chunk();
+            return false;
+        }
+        
+        chunk.optimize();
+        
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "voxel/chunk.hpp"
+
+namespace voxel
+{
+    // Compresses cells for storage and transfer; occupancy and material planes are run-length coded separately,
+    // so that solid and empty runs survive the gradient shells around the surface
+    void encodePlanes(vector<unsigned char>& result, const unsigned char* occupancy, const unsigned char* material, size_t count);
+    
+    // Returns false if the data is malformed or does not hold exactly count cells
+    bool decodePlanes(unsigned char* occupancy, unsigned char* material, size_t count, const unsigned char* data, size_t size);
+    
+    // Chunk cells in x-major order; uniform chunks take a few bytes
+    void encodeChunk(vector<unsigned char>& result, const Chunk& chunk);
+    bool decodeChunk(Chunk& chunk, const unsigned char* data, size_t size);
+}
\ No newline at end of file
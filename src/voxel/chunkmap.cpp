@@ -0,0 +1,163 @@
+#include "common.hpp"
+#include "voxel/chunkmap.hpp"
+
+namespace voxel
+{
+    const unsigned int kKeyBits = 21;
+    const size_t kInitialCapacity = 64;
+    
+    ChunkMap::ChunkMap()
+    : slots(kInitialCapacity, Slot { 0, kEmpty })
+    {
+    }
+    
+    Chunk* ChunkMap::find(const glm::i32vec3& id)
+    {
+        Entry* entry = findEntry(id);
+        
+        return entry ? &entry->chunk : nullptr;
+    }
+    
+    const Chunk* ChunkMap::find(const glm::i32vec3& id) const
+    {
+        const Entry* entry = findEntry(id);
+        
+        return entry ? &entry->chunk : nullptr;
+    }
+    
+    ChunkMap::Entry* ChunkMap::findEntry(const glm::i32vec3& id)
+    {
+        size_t slot = findSlot(getKey(id));
+        
+        return slots[slot].index == kEmpty ? nullptr : &entries[slots[slot].index];
+    }
+    
+    const ChunkMap::Entry* ChunkMap::findEntry(const glm::i32vec3& id) const
+    {
+        size_t slot = findSlot(getKey(id));
+        
+        return slots[slot].index == kEmpty ? nullptr : &entries[slots[slot].index];
+    }
+    
+    Chunk& ChunkMap::operator[](const glm::i32vec3& id)
+    {
+        unsigned long long key = getKey(id);
+        size_t slot = findSlot(key);
+        
+        if (slots[slot].index != kEmpty)
+            return entries[slots[slot].index].chunk;
+        
+        // keep load factor at or below 1/2
+        if ((entries.size() + 1) * 2 > slots.size())
+        {
+            rehash(slots.size() * 2);
+            slot = findSlot(key);
+        }
+        
+        slots[slot] = Slot { key, static_cast<unsigned int>(entries.size()) };
+        entries.push_back(Entry { id, Chunk(), nullptr, 0 });
+        
+        return entries.back().chunk;
+    }
+    
+    bool ChunkMap::erase(const glm::i32vec3& id)
+    {
+        size_t mask = slots.size() - 1;
+        size_t slot = findSlot(getKey(id));
+        
+        if (slots[slot].index == kEmpty)
+            return false;
+        
+        unsigned int index = slots[slot].index;
+        
+        // move the last entry into the hole and repoint its slot
+        if (index + 1 != entries.size())
+        {
+            size_t lastSlot = findSlot(getKey(entries.back().id));
+            assert(slots[lastSlot].index == entries.size() - 1);
+            
+            slots[lastSlot].index = index;
+            entries[index] = move(entries.back());
+        }
+        
+        entries.pop_back();
+        
+        // backward shift deletion keeps probe sequences intact without tombstones
+        size_t hole = slot;
+        
+        for (size_t next = (hole + 1) & mask; slots[next].index != kEmpty; next = (next + 1) & mask)
+        {
+            size_t home = getHash(slots[next].key) & mask;
+            
+            // move the slot into the hole unless its home lies cyclically in (hole, next]
+            if (((next - home) & mask) >= ((next - hole) & mask))
+            {
+                slots[hole] = slots[next];
+                hole = next;
+            }
+        }
+        
+        slots[hole] = Slot { 0, kEmpty };
+        
+        return true;
+    }
+    
+    size_t ChunkMap::getMemoryUsage() const
+    {
+        size_t result = slots.capacity() * sizeof(Slot) + entries.capacity() * sizeof(Entry);
+        
+        for (auto& e: entries)
+            result += e.chunk.getMemoryUsage() - sizeof(Chunk) + (e.mips ? sizeof(ChunkMips) : 0);
+        
+        return result;
+    }
+    
+    unsigned long long ChunkMap::getKey(const glm::i32vec3& id)
+    {
+        const int limit = 1 << (kKeyBits - 1);
+        const unsigned long long mask = (1ull << kKeyBits) - 1;
+        
+        assert(id.x >= -limit && id.x < limit && id.y >= -limit && id.y < limit && id.z >= -limit && id.z < limit);
+        (void)limit;
+        
+        return
+            ((static_cast<unsigned long long>(id.x) & mask) << (kKeyBits * 2)) |
+            ((static_cast<unsigned long long>(id.y) & mask) << kKeyBits) |
+            (static_cast<unsigned long long>(id.z) & mask);
+    }
+    
+    size_t ChunkMap::getHash(unsigned long long key)
+    {
+        // MurmurHash3 64-bit finalizer
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdull;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ull;
+        key ^= key >> 33;
+        
+        return static_cast<size_t>(key);
+    }
+    
+    size_t ChunkMap::findSlot(unsigned long long key) const
+    {
+        size_t mask = slots.size() - 1;
+        
+        for (size_t slot = getHash(key) & mask; ; slot = (slot + 1) & mask)
+            if (slots[slot].index == kEmpty || slots[slot].key == key)
+                return slot;
+    }
+    
+    void ChunkMap::rehash(size_t capacity)
+    {
+        assert((capacity & (capacity - 1)) == 0 && capacity >= entries.size() * 2);
+        
+        slots.assign(capacity, Slot { 0, kEmpty });
+        
+        for (size_t i = 0; i < entries.size(); ++i)
+        {
+            unsigned long long key = getKey(entries[i].id);
+            
+            slots[findSlot(key)] = Slot { key, static_cast<unsigned int>(i) };
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "voxel/chunk.hpp"
+#include "voxel/chunkmips.hpp"
+
+namespace voxel
+{
+    // Open addressing chunk directory; chunks are stored contiguously and may move on insert/erase
+    class ChunkMap
+    {
+    public:
+        struct Entry
+        {
+            glm::i32vec3 id;
+            Chunk chunk;
+            
+            // mips of chunks with non-uniform storage, maintained by the owner
+            unique_ptr<ChunkMips> mips;
+            
+            // access stamp maintained by the owner for eviction
+            unsigned int lastAccess;
+        };
+        
+        ChunkMap();
+        
+        Chunk* find(const glm::i32vec3& id);
+        const Chunk* find(const glm::i32vec3& id) const;
+        
+        Entry* findEntry(const glm::i32vec3& id);
+        const Entry* findEntry(const glm::i32vec3& id) const;
+        
+        Chunk& operator[](const glm::i32vec3& id);
+        
+        bool erase(const glm::i32vec3& id);
+        
+        size_t size() const { return entries.size(); }
+        
+        vector<Entry>::iterator begin() { return entries.begin(); }
+        vector<Entry>::iterator end() { return entries.end(); }
+        vector<Entry>::const_iterator begin() const { return entries.begin(); }
+        vector<Entry>::const_iterator end() const { return entries.end(); }
+        
+        size_t getMemoryUsage() const;
+        
+    private:
+        static const unsigned int kEmpty = ~0u;
+        
+        struct Slot
+        {
+            unsigned long long key;
+            unsigned int index;
+        };
+        
+        static unsigned long long getKey(const glm::i32vec3& id);
+        static size_t getHash(unsigned long long key);
+        
+        size_t findSlot(unsigned long long key) const;
+        
+        void rehash(size_t capacity);
+        
+        vector<Slot> slots;
+        vector<Entry> entries;
+    };
+}
\ No newline at end of file
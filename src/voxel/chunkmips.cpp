@@ -0,0 +1,67 @@
+#include "common.hpp"
+#include "voxel/chunkmips.hpp"
+
+namespace voxel
+{
+    void ChunkMips::update(const Chunk& chunk, const Region& region)
+    {
+        assert(!region.empty());
+        
+        glm::i32vec3 begin = region.begin() >> 1;
+        glm::i32vec3 end = ((region.end() - 1) >> 1) + 1;
+        
+        unsigned char rows[4][kChunkSize];
+        
+        // level 1 reduces 2x2x2 chunk cells, read as four rows per mip row
+        for (int z = begin.z; z < end.z; ++z)
+            for (int y = begin.y; y < end.y; ++y)
+            {
+                unsigned int count = (end.x - begin.x) * 2;
+                
+                for (int i = 0; i < 4; ++i)
+                    chunk.read(rows[i], nullptr, begin.x * 2, y * 2 + (i & 1), z * 2 + (i >> 1), count);
+                
+                for (int x = begin.x; x < end.x; ++x)
+                {
+                    unsigned int sum = 0;
+                    unsigned int max = 0;
+                    
+                    for (int i = 0; i < 4; ++i)
+                        for (int j = 0; j < 2; ++j)
+                        {
+                            unsigned int occupancy = rows[i][(x - begin.x) * 2 + j];
+                            
+                            sum += occupancy;
+                            max = std::max(max, occupancy);
+                        }
+                    
+                    at(1, x, y, z) = MipCell { static_cast<unsigned char>((sum + 4) / 8), static_cast<unsigned char>(max) };
+                }
+            }
+        
+        // coarser levels reduce the level below; the mean is a mean of rounded means
+        for (unsigned int level = 2; level <= kChunkSizeLog2; ++level)
+        {
+            begin = begin >> 1;
+            end = ((end - 1) >> 1) + 1;
+            
+            for (int z = begin.z; z < end.z; ++z)
+                for (int y = begin.y; y < end.y; ++y)
+                    for (int x = begin.x; x < end.x; ++x)
+                    {
+                        unsigned int sum = 0;
+                        unsigned int max = 0;
+                        
+                        for (int i = 0; i < 8; ++i)
+                        {
+                            const MipCell& child = at(level - 1, x * 2 + (i & 1), y * 2 + ((i >> 1) & 1), z * 2 + (i >> 2));
+                            
+                            sum += child.mean;
+                            max = std::max(max, child.max + 0u);
+                        }
+                        
+                        at(level, x, y, z) = MipCell { static_cast<unsigned char>((sum + 4) / 8), static_cast<unsigned char>(max) };
+                    }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "voxel/chunk.hpp"
+
+namespace voxel
+{
+    struct MipCell
+    {
+        unsigned char mean;
+        unsigned char max;
+    };
+    
+    // Occupancy of a chunk reduced over 2^level cubes, for levels 1 to kChunkSizeLog2
+    class ChunkMips
+    {
+    public:
+        // Recomputes mip cells that cover the region on every level; region is in chunk cells
+        void update(const Chunk& chunk, const Region& region);
+        
+        const MipCell& get(unsigned int level, unsigned int x, unsigned int y, unsigned int z) const
+        {
+            unsigned int size = kChunkSize >> level;
+            
+            assert(level > 0 && level <= kChunkSizeLog2 && x < size && y < size && z < size);
+            return cells[getLevelOffset(level) + x + size * (y + size * z)];
+        }
+        
+    private:
+        static unsigned int getLevelOffset(unsigned int level)
+        {
+            unsigned int result = 0;
+            
+            for (unsigned int l = 1; l < level; ++l)
+                result += (kChunkSize >> l) * (kChunkSize >> l) * (kChunkSize >> l);
+            
+            return result;
+        }
+        
+        MipCell& at(unsigned int level, unsigned int x, unsigned int y, unsigned int z)
+        {
+            unsigned int size = kChunkSize >> level;
+            
+            return cells[getLevelOffset(level) + x + size * (y + size * z)];
+        }
+        
+        MipCell cells[(kChunkSize * kChunkSize * kChunkSize - 1) / 7];
+    };
+}
\ No newline at end of file
@@ -0,0 +1,552 @@
+#include "common.hpp"
+#include "voxel/chunkstore.hpp"
+
+#include "voxel/chunkcodec.hpp"
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+#include <stdexcept>
+
+namespace voxel
+{
+    const unsigned int kRegionSizeLog2 = 4;
+    const unsigned int kRegionSize = 1 << kRegionSizeLog2;
+    const unsigned int kRegionChunks = kRegionSize * kRegionSize * kRegionSize;
+    
+    const char kRegionMagic[4] = { 'S', 'V', 'R', 'G' };
+    const unsigned int kRegionVersion = 2;
+    
+    // files are compacted by ChunkStore::compact once stale records take more space than live ones
+    const size_t kRegionCompactGarbageMin = 1 << 20;
+    
+    struct RegionHeader
+    {
+        char magic[4];
+        unsigned int version;
+        unsigned int reserved[2];
+    };
+    
+    // file offset and size of a chunk record; size 0 means the chunk is not stored
+    struct RegionEntry
+    {
+        unsigned int offset;
+        unsigned int size;
+    };
+    
+    const size_t kRegionDataOffset = sizeof(RegionHeader) + kRegionChunks * sizeof(RegionEntry);
+    
+    // entries hold 32-bit offsets, so records can not be appended past this size
+    const size_t kRegionFileSizeMax = ~0u;
+    
+    static bool hasUniqueIndices(const vector<pair<unsigned int, const vector<unsigned char>*>>& records)
+    {
+        unordered_set<unsigned int> indices;
+        
+        for (auto& r: records)
+            if (!indices.insert(r.first).second)
+                return false;
+        
+        return true;
+    }
+    
+    static string getRegionPath(const string& folder, const glm::i32vec3& id)
+    {
+        char name[64];
+        snprintf(name, sizeof(name), "r.%d.%d.%d.svr", id.x, id.y, id.z);
+        
+        return folder + "/" + name;
+    }
+    
+    static void writeAll(int fd, const void* data, size_t size, size_t offset, const string& path)
+    {
+        const char* ptr = static_cast<const char*>(data);
+        
+        while (size > 0)
+        {
+            ssize_t written = pwrite(fd, ptr, size, offset);
+            
+            if (written < 0 && errno == EINTR)
+                continue;
+            
+            if (written <= 0)
+                throw runtime_error("Failed to write " + path);
+            
+            ptr += written;
+            size -= written;
+            offset += written;
+        }
+    }
+    
+    static void syncData(int fd, const string& path)
+    {
+    #ifdef __APPLE__
+        int rc = fsync(fd);
+    #else
+        int rc = fdatasync(fd);
+    #endif
+        
+        if (rc != 0)
+            throw runtime_error("Failed to sync " + path);
+    }
+    
+    static void syncFolder(const string& path)
+    {
+        string folder = path.substr(0, path.find_last_of('/'));
+        
+        int fd = ::open(folder.c_str(), O_RDONLY);
+        
+        if (fd < 0)
+            throw runtime_error("Failed to open " + folder);
+        
+        int rc = fsync(fd);
+        ::close(fd);
+        
+        if (rc != 0)
+            throw runtime_error("Failed to sync " + folder);
+    }
+    
+    // Owns a file descriptor so that a constructor throwing halfway does not leak it
+    class FileHandle: noncopyable
+    {
+    public:
+        FileHandle(): fd(-1)
+        {
+        }
+        
+        ~FileHandle()
+        {
+            reset();
+        }
+        
+        int get() const { return fd; }
+        
+        void reset(int value = -1)
+        {
+            if (fd >= 0)
+                ::close(fd);
+            
+            fd = value;
+        }
+        
+    private:
+        int fd;
+    };
+    
+    class RegionFile: noncopyable
+    {
+    public:
+        RegionFile(const string& path, bool create)
+        : path(path)
+        , table(kRegionChunks)
+        , size(0)
+        , garbage(0)
+        , unsynced(false)
+        , mapping(nullptr)
+        , mappingSize(0)
+        {
+            open(create);
+        }
+        
+        ~RegionFile()
+        {
+            close();
+        }
+        
+        bool load(unsigned int index, Chunk& chunk)
+        {
+            const RegionEntry& entry = table[index];
+            
+            if (entry.size == 0)
+                return false;
+            
+            // appended records are past the end of the mapping until it is refreshed
+            if (size_t(entry.offset) + entry.size > mappingSize)
+                map();
+            
+            if (!decodeChunk(chunk, mapping + entry.offset, entry.size))
+                throw runtime_error("Corrupted chunk record in " + path);
+            
+            return true;
+        }
+        
+        void save(const vector<pair<unsigned int, const vector<unsigned char>*>>& records)
+        {
+            if (records.empty())
+                return;
+            
+            // a repeated index would leave the first record of the batch unreferenced
+            assert(hasUniqueIndices(records));
+            
+            size_t appended = 0;
+            
+            for (auto& r: records)
+                appended += r.second->size();
+            
+            // stale records are dropped before giving up on a file that would outgrow 32-bit offsets
+            if (size + appended > kRegionFileSizeMax && garbage > 0)
+                compact();
+            
+            if (size + appended > kRegionFileSizeMax)
+                throw runtime_error("Region file is full " + path);
+            
+            vector<RegionEntry> entries;
+            entries.reserve(records.size());
+            
+            for (auto& r: records)
+            {
+                const vector<unsigned char>& data = *r.second;
+                assert(!data.empty());
+                
+                entries.push_back(RegionEntry { static_cast<unsigned int>(size), static_cast<unsigned int>(data.size()) });
+                
+                writeAll(fd.get(), data.data(), data.size(), size, path);
+                size += data.size();
+            }
+            
+            // the records have to reach the disk before the entries that point to them
+            syncData(fd.get(), path);
+            
+            unsigned int first = kRegionChunks, last = 0;
+            
+            for (size_t i = 0; i < records.size(); ++i)
+            {
+                unsigned int index = records[i].first;
+                
+                garbage += table[index].size;
+                table[index] = entries[i];
+                
+                first = min(first, index);
+                last = max(last, index);
+            }
+            
+            // changed entries go out in one write and one sync; a crash in between may keep any subset of them,
+            // so a batch is not atomic, but every entry that survives points to a synced record
+            writeAll(fd.get(), &table[first], (last - first + 1) * sizeof(RegionEntry), sizeof(RegionHeader) + first * sizeof(RegionEntry), path);
+            syncData(fd.get(), path);
+            
+            unsynced = false;
+        }
+        
+        // erased entries are not synced on their own; the next save or sync of this file covers them
+        void erase(unsigned int index)
+        {
+            if (table[index].size == 0)
+                return;
+            
+            garbage += table[index].size;
+            table[index] = RegionEntry { 0, 0 };
+            
+            writeAll(fd.get(), &table[index], sizeof(RegionEntry), sizeof(RegionHeader) + index * sizeof(RegionEntry), path);
+            
+            unsynced = true;
+        }
+        
+        void sync()
+        {
+            if (!unsynced)
+                return;
+            
+            syncData(fd.get(), path);
+            
+            unsynced = false;
+        }
+        
+        bool empty() const
+        {
+            return all_of(table.begin(), table.end(), [](const RegionEntry& e) { return e.size == 0; });
+        }
+        
+        const vector<RegionEntry>& getTable() const { return table; }
+        
+        void collectGarbage()
+        {
+            if (garbage >= kRegionCompactGarbageMin && garbage > size - kRegionDataOffset - garbage)
+                compact();
+        }
+        
+    private:
+        void open(bool create)
+        {
+            struct stat st;
+            
+            // new files are written in full and renamed into place like compacted ones; a file shorter than the table
+            // was cut off while being created and can not hold a synced entry, so it is recreated empty
+            if (stat(path.c_str(), &st) == 0 ? size_t(st.st_size) < kRegionDataOffset : (errno == ENOENT && create))
+                replace([](int, const string&, vector<RegionEntry>&) {});
+            
+            fd.reset(::open(path.c_str(), O_RDWR));
+            
+            if (fd.get() < 0)
+                throw runtime_error("Failed to open " + path);
+            
+            if (fstat(fd.get(), &st) != 0)
+                throw runtime_error("Failed to open " + path);
+            
+            RegionHeader header;
+            
+            if (size_t(st.st_size) < kRegionDataOffset || pread(fd.get(), &header, sizeof(header), 0) != sizeof(header) ||
+                memcmp(header.magic, kRegionMagic, sizeof(kRegionMagic)) != 0 || header.version != kRegionVersion)
+                throw runtime_error("Unsupported region file " + path);
+            
+            if (pread(fd.get(), table.data(), table.size() * sizeof(RegionEntry), sizeof(header)) != ssize_t(table.size() * sizeof(RegionEntry)))
+                throw runtime_error("Failed to read " + path);
+            
+            size = st.st_size;
+            
+            // records that are not referenced by the table are stale
+            size_t live = 0;
+            
+            for (auto& e: table)
+            {
+                if (e.size != 0 && (e.offset < kRegionDataOffset || size_t(e.offset) + e.size > size))
+                    throw runtime_error("Corrupted chunk table in " + path);
+                
+                live += e.size;
+            }
+            
+            garbage = size - kRegionDataOffset - live;
+            
+            map();
+        }
+        
+        void close()
+        {
+            unmap();
+            
+            fd.reset();
+        }
+        
+        void map()
+        {
+            unmap();
+            
+            void* result = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd.get(), 0);
+            
+            if (result == MAP_FAILED)
+                throw runtime_error("Failed to map " + path);
+            
+            mapping = static_cast<const unsigned char*>(result);
+            mappingSize = size;
+        }
+        
+        void unmap()
+        {
+            if (mapping)
+                munmap(const_cast<unsigned char*>(mapping), mappingSize);
+            
+            mapping = nullptr;
+            mappingSize = 0;
+        }
+        
+        // Writes records through the callback, then the header and table, to a temporary file that replaces the region file
+        void replace(const function<void (int, const string&, vector<RegionEntry>&)>& writeRecords)
+        {
+            string tempPath = path + ".tmp";
+            
+            int tempFd = ::open(tempPath.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+            
+            if (tempFd < 0)
+                throw runtime_error("Failed to open " + tempPath);
+            
+            // a failed write leaves the region as it was; the temporary file is skipped on open and overwritten by the next replace
+            try
+            {
+                vector<RegionEntry> newTable(kRegionChunks, RegionEntry { 0, 0 });
+                
+                writeRecords(tempFd, tempPath, newTable);
+                
+                RegionHeader header = {};
+                memcpy(header.magic, kRegionMagic, sizeof(kRegionMagic));
+                header.version = kRegionVersion;
+                
+                writeAll(tempFd, &header, sizeof(header), 0, tempPath);
+                writeAll(tempFd, newTable.data(), newTable.size() * sizeof(RegionEntry), sizeof(RegionHeader), tempPath);
+                
+                if (fsync(tempFd) != 0)
+                    throw runtime_error("Failed to sync " + tempPath);
+            }
+            catch (...)
+            {
+                ::close(tempFd);
+                unlink(tempPath.c_str());
+                throw;
+            }
+            
+            ::close(tempFd);
+            
+            if (rename(tempPath.c_str(), path.c_str()) != 0)
+                throw runtime_error("Failed to replace " + path);
+            
+            // the rename is only durable once the folder entry is
+            syncFolder(path);
+        }
+        
+        void compact()
+        {
+            map();
+            
+            replace([&](int tempFd, const string& tempPath, vector<RegionEntry>& newTable) {
+                size_t newSize = kRegionDataOffset;
+                
+                for (unsigned int i = 0; i < kRegionChunks; ++i)
+                    if (table[i].size != 0)
+                    {
+                        writeAll(tempFd, mapping + table[i].offset, table[i].size, newSize, tempPath);
+                        
+                        newTable[i] = RegionEntry { static_cast<unsigned int>(newSize), table[i].size };
+                        newSize += table[i].size;
+                    }
+            });
+            
+            close();
+            open(false);
+            
+            // the rewritten table was synced with the temporary file
+            unsynced = false;
+        }
+        
+        string path;
+        FileHandle fd;
+        
+        vector<RegionEntry> table;
+        size_t size;
+        size_t garbage;
+        bool unsynced;
+        
+        const unsigned char* mapping;
+        size_t mappingSize;
+    };
+    
+    static unsigned int getRegionIndex(const glm::i32vec3& id)
+    {
+        glm::i32vec3 local = id - (id >> int(kRegionSizeLog2)) * int(kRegionSize);
+        
+        return local.x + kRegionSize * (local.y + kRegionSize * local.z);
+    }
+    
+    ChunkStore::ChunkStore(const string& path)
+    : path(path)
+    {
+        if (mkdir(path.c_str(), 0755) != 0 && errno != EEXIST)
+            throw runtime_error("Failed to create " + path);
+        
+        DIR* dir = opendir(path.c_str());
+        
+        if (!dir)
+            throw runtime_error("Failed to open " + path);
+        
+        vector<glm::i32vec3> ids;
+        
+        while (dirent* entry = readdir(dir))
+        {
+            glm::i32vec3 id;
+            
+            // the name check skips leftover temporary files from an interrupted compaction
+            if (sscanf(entry->d_name, "r.%d.%d.%d.svr", &id.x, &id.y, &id.z) == 3 && getRegionPath(path, id) == path + "/" + entry->d_name)
+                ids.push_back(id);
+        }
+        
+        closedir(dir);
+        
+        // region tables are read upfront; chunk records are only touched on load
+        for (auto& id: ids)
+            regions[id].reset(new RegionFile(getRegionPath(path, id), false));
+    }
+    
+    ChunkStore::~ChunkStore()
+    {
+    }
+    
+    bool ChunkStore::load(const glm::i32vec3& id, Chunk& chunk)
+    {
+        RegionFile* region = getRegion(id, false);
+        
+        return region && region->load(getRegionIndex(id), chunk);
+    }
+    
+    bool ChunkStore::contains(const glm::i32vec3& id) const
+    {
+        auto it = regions.find(id >> int(kRegionSizeLog2));
+        
+        return it != regions.end() && it->second->getTable()[getRegionIndex(id)].size != 0;
+    }
+    
+    void ChunkStore::save(const glm::i32vec3& id, const Chunk& chunk)
+    {
+        vector<unsigned char> data;
+        encodeChunk(data, chunk);
+        
+        save(id, data);
+    }
+    
+    void ChunkStore::save(const glm::i32vec3& id, const vector<unsigned char>& data)
+    {
+        getRegion(id, true)->save({ make_pair(getRegionIndex(id), &data) });
+    }
+    
+    void ChunkStore::save(const vector<pair<glm::i32vec3, vector<unsigned char>>>& chunks)
+    {
+        unordered_map<RegionFile*, vector<pair<unsigned int, const vector<unsigned char>*>>> records;
+        
+        for (auto& c: chunks)
+            records[getRegion(c.first, true)].push_back(make_pair(getRegionIndex(c.first), &c.second));
+        
+        for (auto& p: records)
+            p.first->save(p.second);
+        
+        // erasures in regions without new records still have to reach the disk
+        for (auto& p: regions)
+            p.second->sync();
+    }
+    
+    void ChunkStore::erase(const glm::i32vec3& id)
+    {
+        if (RegionFile* region = getRegion(id, false))
+            region->erase(getRegionIndex(id));
+    }
+    
+    void ChunkStore::compact()
+    {
+        for (auto& p: regions)
+            p.second->collectGarbage();
+    }
+    
+    vector<glm::i32vec3> ChunkStore::getChunks() const
+    {
+        vector<glm::i32vec3> result;
+        
+        for (auto& p: regions)
+        {
+            const vector<RegionEntry>& table = p.second->getTable();
+            
+            for (unsigned int i = 0; i < kRegionChunks; ++i)
+                if (table[i].size != 0)
+                    result.push_back(p.first * int(kRegionSize) + glm::i32vec3(i % kRegionSize, (i / kRegionSize) % kRegionSize, i / (kRegionSize * kRegionSize)));
+        }
+        
+        return result;
+    }
+    
+    RegionFile* ChunkStore::getRegion(const glm::i32vec3& id, bool create)
+    {
+        glm::i32vec3 rid = id >> int(kRegionSizeLog2);
+        
+        auto it = regions.find(rid);
+        
+        if (it != regions.end())
+            return it->second.get();
+        
+        if (!create)
+            return nullptr;
+        
+        RegionFile* result = new RegionFile(getRegionPath(path, rid), true);
+        regions[rid].reset(result);
+        
+        return result;
+    }
+}
\ No newline at end of file
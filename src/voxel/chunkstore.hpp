@@ -0,0 +1,47 @@
+#pragma once
+
+#include "voxel/chunk.hpp"
+
+namespace voxel
+{
+    class RegionFile;
+    
+    // On-disk chunk storage in a folder of region files with kRegionSize^3 chunks each;
+    // chunk data is memory mapped and decoded on demand, and rewritten chunks are appended until compact is called
+    class ChunkStore: noncopyable
+    {
+    public:
+        explicit ChunkStore(const string& path);
+        ~ChunkStore();
+        
+        // Returns false if the chunk is not stored
+        bool load(const glm::i32vec3& id, Chunk& chunk);
+        
+        // Checks the region table only, without touching the chunk record
+        bool contains(const glm::i32vec3& id) const;
+        
+        void save(const glm::i32vec3& id, const Chunk& chunk);
+        
+        // Stores data produced by encodeChunk as is
+        void save(const glm::i32vec3& id, const vector<unsigned char>& data);
+        
+        // Stores several encoded chunks with unique ids; records and table entries are synced once per region file
+        // instead of once per chunk. A batch is not atomic: after a crash each chunk is either old or new
+        void save(const vector<pair<glm::i32vec3, vector<unsigned char>>>& chunks);
+        
+        // Erased chunks reach the disk with the next batch save
+        void erase(const glm::i32vec3& id);
+        
+        // Rewrites region files where stale records take more space than live ones
+        void compact();
+        
+        vector<glm::i32vec3> getChunks() const;
+        
+    private:
+        RegionFile* getRegion(const glm::i32vec3& id, bool create);
+        
+        string path;
+        
+        unordered_map<glm::i32vec3, unique_ptr<RegionFile>> regions;
+    };
+}
\ No newline at end of file
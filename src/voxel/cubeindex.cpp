@@ -0,0 +1,120 @@
+#include "common.hpp"
+#include "voxel/cubeindex.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace voxel
+{
+    void classifyOccupancy(unsigned char* signs, const unsigned char* occupancy, unsigned int count, unsigned char threshold)
+    {
+        if (threshold == 0)
+        {
+            memset(signs, 0, count);
+            return;
+        }
+        
+        unsigned int i = 0;
+        
+    #if defined(__AVX2__)
+        __m256i limit = _mm256_set1_epi8(char(threshold - 1));
+        __m256i one = _mm256_set1_epi8(1);
+        
+        for (; i + 32 <= count; i += 32)
+        {
+            __m256i occ = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(occupancy + i));
+            __m256i below = _mm256_cmpeq_epi8(_mm256_min_epu8(occ, limit), occ);
+            
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(signs + i), _mm256_and_si256(below, one));
+        }
+    #elif defined(__SSE2__)
+        __m128i limit = _mm_set1_epi8(char(threshold - 1));
+        __m128i one = _mm_set1_epi8(1);
+        
+        for (; i + 16 <= count; i += 16)
+        {
+            __m128i occ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(occupancy + i));
+            __m128i below = _mm_cmpeq_epi8(_mm_min_epu8(occ, limit), occ);
+            
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(signs + i), _mm_and_si128(below, one));
+        }
+    #endif
+        
+        for (; i < count; ++i)
+            signs[i] = occupancy[i] < threshold;
+    }
+    
+    unsigned int computeCubeIndices(unsigned char* indices,
+        const unsigned char* s00, const unsigned char* s10, const unsigned char* s01, const unsigned char* s11,
+        unsigned int count)
+    {
+        unsigned int surface = 0;
+        unsigned int i = 0;
+        
+        // signs are 0 or 1, so 16-bit shifts by less than 8 never carry into the neighbouring byte
+    #if defined(__AVX2__)
+        __m256i zero = _mm256_setzero_si256();
+        __m256i full = _mm256_set1_epi8(char(0xff));
+        
+        for (; i + 32 <= count; i += 32)
+        {
+            #define LOAD(s, o) _mm256_loadu_si256(reinterpret_cast<const __m256i*>(s + i + o))
+            
+            __m256i ci = _mm256_or_si256(
+                _mm256_or_si256(
+                    _mm256_or_si256(LOAD(s00, 0), _mm256_slli_epi16(LOAD(s00, 1), 1)),
+                    _mm256_or_si256(_mm256_slli_epi16(LOAD(s10, 1), 2), _mm256_slli_epi16(LOAD(s10, 0), 3))),
+                _mm256_or_si256(
+                    _mm256_or_si256(_mm256_slli_epi16(LOAD(s01, 0), 4), _mm256_slli_epi16(LOAD(s01, 1), 5)),
+                    _mm256_or_si256(_mm256_slli_epi16(LOAD(s11, 1), 6), _mm256_slli_epi16(LOAD(s11, 0), 7))));
+            
+            #undef LOAD
+            
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(indices + i), ci);
+            
+            unsigned int uniform = _mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(ci, zero), _mm256_cmpeq_epi8(ci, full)));
+            
+            surface += 32 - __builtin_popcount(uniform);
+        }
+    #elif defined(__SSE2__)
+        __m128i zero = _mm_setzero_si128();
+        __m128i full = _mm_set1_epi8(char(0xff));
+        
+        for (; i + 16 <= count; i += 16)
+        {
+            #define LOAD(s, o) _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + o))
+            
+            __m128i ci = _mm_or_si128(
+                _mm_or_si128(
+                    _mm_or_si128(LOAD(s00, 0), _mm_slli_epi16(LOAD(s00, 1), 1)),
+                    _mm_or_si128(_mm_slli_epi16(LOAD(s10, 1), 2), _mm_slli_epi16(LOAD(s10, 0), 3))),
+                _mm_or_si128(
+                    _mm_or_si128(_mm_slli_epi16(LOAD(s01, 0), 4), _mm_slli_epi16(LOAD(s01, 1), 5)),
+                    _mm_or_si128(_mm_slli_epi16(LOAD(s11, 1), 6), _mm_slli_epi16(LOAD(s11, 0), 7))));
+            
+            #undef LOAD
+            
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(indices + i), ci);
+            
+            unsigned int uniform = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(ci, zero), _mm_cmpeq_epi8(ci, full)));
+            
+            surface += 16 - __builtin_popcount(uniform);
+        }
+    #endif
+        
+        for (; i < count; ++i)
+        {
+            unsigned int ci =
+                (s00[i] << 0) | (s00[i + 1] << 1) | (s10[i + 1] << 2) | (s10[i] << 3) |
+                (s01[i] << 4) | (s01[i + 1] << 5) | (s11[i + 1] << 6) | (s11[i] << 7);
+            
+            indices[i] = ci;
+            surface += (ci != 0 && ci != 255);
+        }
+        
+        return surface;
+    }
+}
\ No newline at end of file
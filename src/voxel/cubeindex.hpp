@@ -0,0 +1,32 @@
+#pragma once
+
+#include "voxel/box.hpp"
+
+namespace voxel
+{
+    // Writes 1 for cells with occupancy below threshold (outside of the surface) and 0 for the rest
+    void classifyOccupancy(unsigned char* signs, const unsigned char* occupancy, unsigned int count, unsigned char threshold);
+    
+    // Computes cube indices for count cubes from sign rows at (y, z), (y + 1, z), (y, z + 1) and (y + 1, z + 1);
+    // sign rows need count + 1 entries. Returns the number of cubes that cross the surface.
+    unsigned int computeCubeIndices(unsigned char* indices,
+        const unsigned char* s00, const unsigned char* s10, const unsigned char* s01, const unsigned char* s11,
+        unsigned int count);
+    
+    // Classifies cells of slice z of a box or grid view into a width * height sign array
+    template <typename Volume> void classifySlice(unsigned char* signs, const Volume& volume, unsigned int z, unsigned char threshold)
+    {
+        unsigned int width = volume.getWidth(), height = volume.getHeight();
+        
+        for (unsigned int y = 0; y < height; ++y)
+            for (unsigned int x = 0; x < width; )
+            {
+                unsigned int count = width - x;
+                const unsigned char* row = volume.getOccupancyRow(x, y, z, count);
+                
+                classifyOccupancy(signs + x + width * y, row, count, threshold);
+                
+                x += count;
+            }
+    }
+}
\ No newline at end of file
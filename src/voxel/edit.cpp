@@ -0,0 +1,37 @@
+#include "common.hpp"
+#include "voxel/edit.hpp"
+
+namespace voxel
+{
+    void Edit::set(const Region& region, const Cell& cell)
+    {
+        if (!region.empty())
+            operations.push_back(Operation { Type_Set, region, cell, 0, Function() });
+    }
+    
+    void Edit::min(const Region& region, unsigned char occupancy)
+    {
+        if (!region.empty())
+            operations.push_back(Operation { Type_Min, region, Cell {}, occupancy, Function() });
+    }
+    
+    void Edit::max(const Region& region, unsigned char occupancy)
+    {
+        if (!region.empty())
+            operations.push_back(Operation { Type_Max, region, Cell {}, occupancy, Function() });
+    }
+    
+    void Edit::add(const Region& region, int occupancy)
+    {
+        if (!region.empty())
+            operations.push_back(Operation { Type_Add, region, Cell {}, occupancy, Function() });
+    }
+    
+    void Edit::apply(const Region& region, const Function& function)
+    {
+        assert(function);
+        
+        if (!region.empty())
+            operations.push_back(Operation { Type_Function, region, Cell {}, 0, function });
+    }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "voxel/box.hpp"
+
+namespace voxel
+{
+    // Batch of region operations applied to a grid in one pass over the affected chunks; see Grid::apply
+    class Edit
+    {
+    public:
+        typedef function<void(const glm::i32vec3& position, Cell& cell)> Function;
+        
+        void set(const Region& region, const Cell& cell);
+        
+        // Occupancy operations; material is left intact, add saturates to [0, 255]
+        void min(const Region& region, unsigned char occupancy);
+        void max(const Region& region, unsigned char occupancy);
+        void add(const Region& region, int occupancy);
+        
+        void apply(const Region& region, const Function& function);
+        
+        enum Type
+        {
+            Type_Set,
+            Type_Min,
+            Type_Max,
+            Type_Add,
+            Type_Function
+        };
+        
+        struct Operation
+        {
+            Type type;
+            Region region;
+            Cell cell;
+            int value;
+            Function function;
+        };
+        
+        const vector<Operation>& getOperations() const { return operations; }
+        
+        bool empty() const { return operations.empty(); }
+        
+    private:
+        vector<Operation> operations;
+    };
+}
\ No newline at end of file
@@ -1,36 +1,23 @@
 #include "common.hpp"
 #include "voxel/grid.hpp"
 
+#include "voxel/edit.hpp"
+#include "voxel/chunkstore.hpp"
+#include "voxel/chunkcodec.hpp"
+
+#include <cstdio>
+
 namespace voxel
 {
-    const unsigned int kChunkSizeLog2 = 5;
-    const unsigned int kChunkSize = 1 << kChunkSizeLog2;
-    
-    Region Region::intersect(const Region& other) const
+    Region Grid::getChunkRegion(const glm::i32vec3& id)
     {
-        glm::i32vec3 ibegin = glm::max(begin(), other.begin());
-        glm::i32vec3 iend = glm::min(end(), other.end());
-        
-        return Region(ibegin, glm::max(ibegin, iend));
-    }
- 
-    Box::Box(unsigned int width, unsigned int height, unsigned int depth)
-    : width(width)
-    , height(height)
-    , depth(depth)
-    , slice(width * height)
-    {
-        data.reset(new Cell[width * height * depth]);
-        
-        fill(data.get(), data.get() + width * height * depth, Cell { 0, 0 });
+        return Region(id * int(kChunkSize), kChunkSize);
     }
     
-    static vector<glm::i32vec3> getChunkIds(const Region& region)
+    template <typename F> static void forEachChunk(const Region& region, F f)
     {
         if (region.empty())
-            return {};
-        
-        vector<glm::i32vec3> result;
+            return;
         
         glm::i32vec3 min = region.begin() >> int(kChunkSizeLog2);
         glm::i32vec3 max = (region.end() - 1) >> int(kChunkSizeLog2);
@@ -38,72 +25,654 @@ namespace voxel
         for (int z = min.z; z <= max.z; ++z)
             for (int y = min.y; y <= max.y; ++y)
                 for (int x = min.x; x <= max.x; ++x)
-                    result.push_back(glm::i32vec3(x, y, z));
+                    f(glm::i32vec3(x, y, z));
+    }
+    
+    vector<glm::i32vec3> Grid::getChunkIds(const Region& region)
+    {
+        vector<glm::i32vec3> result;
+        
+        forEachChunk(region, [&](const glm::i32vec3& cid) { result.push_back(cid); });
         
         return result;
     }
     
-    static void copyCells(Box& targetBox, const Region& targetRegion, const Box& sourceBox, const Region& sourceRegion)
+    static bool isEmpty(const Chunk& chunk)
+    {
+        return chunk.isUniform() && chunk.getUniformCell().occupancy == 0 && chunk.getUniformCell().material == 0;
+    }
+    
+    static void readCells(Box& targetBox, const Region& targetRegion, const Chunk& chunk, const Region& chunkRegion)
     {
-        Region region = sourceRegion.intersect(targetRegion);
+        Region region = chunkRegion.intersect(targetRegion);
         
         if (region.empty())
             return;
         
-        glm::ivec3 sourceOffset = region.begin() - sourceRegion.begin();
+        glm::ivec3 sourceOffset = region.begin() - chunkRegion.begin();
         glm::ivec3 targetOffset = region.begin() - targetRegion.begin();
         
         glm::ivec3 size = region.size();
         
+        BoxPlane<unsigned char> occupancy = targetBox.getOccupancy();
+        BoxPlane<unsigned char> material = targetBox.getMaterial();
+        
+        for (int z = 0; z < size.z; ++z)
+            for (int y = 0; y < size.y; ++y)
+                chunk.read(&occupancy(targetOffset.x, targetOffset.y + y, targetOffset.z + z), &material(targetOffset.x, targetOffset.y + y, targetOffset.z + z),
+                    sourceOffset.x, sourceOffset.y + y, sourceOffset.z + z, size.x);
+    }
+    
+    static void writeCells(Chunk& chunk, const Region& chunkRegion, const Box& sourceBox, const Region& sourceRegion)
+    {
+        Region region = sourceRegion.intersect(chunkRegion);
+        
+        if (region.empty())
+            return;
+        
+        glm::ivec3 sourceOffset = region.begin() - sourceRegion.begin();
+        glm::ivec3 targetOffset = region.begin() - chunkRegion.begin();
+        
+        glm::ivec3 size = region.size();
+        
+        BoxPlane<const unsigned char> occupancy = sourceBox.getOccupancy();
+        BoxPlane<const unsigned char> material = sourceBox.getMaterial();
+        
         for (int z = 0; z < size.z; ++z)
             for (int y = 0; y < size.y; ++y)
+                chunk.write(&occupancy(sourceOffset.x, sourceOffset.y + y, sourceOffset.z + z), &material(sourceOffset.x, sourceOffset.y + y, sourceOffset.z + z),
+                    targetOffset.x, targetOffset.y + y, targetOffset.z + z, size.x);
+    }
+    
+    static void applyOperation(Cell* cells, unsigned int count, const glm::i32vec3& position, const Edit::Operation& op)
+    {
+        switch (op.type)
+        {
+        case Edit::Type_Set:
+            fill(cells, cells + count, op.cell);
+            break;
+            
+        case Edit::Type_Min:
+            for (unsigned int i = 0; i < count; ++i)
+                cells[i].occupancy = std::min(cells[i].occupancy + 0, op.value);
+            break;
+            
+        case Edit::Type_Max:
+            for (unsigned int i = 0; i < count; ++i)
+                cells[i].occupancy = std::max(cells[i].occupancy + 0, op.value);
+            break;
+            
+        case Edit::Type_Add:
+            for (unsigned int i = 0; i < count; ++i)
+                cells[i].occupancy = glm::clamp(cells[i].occupancy + op.value, 0, 255);
+            break;
+            
+        case Edit::Type_Function:
+            for (unsigned int i = 0; i < count; ++i)
+                op.function(position + glm::i32vec3(i, 0, 0), cells[i]);
+            break;
+        }
+    }
+    
+    static Region getEditRegion(const Edit& edit, const Region& chunkRegion)
+    {
+        glm::i32vec3 begin = chunkRegion.end();
+        glm::i32vec3 end = chunkRegion.begin();
+        
+        for (auto& op: edit.getOperations())
+        {
+            Region region = op.region.intersect(chunkRegion);
+            
+            if (!region.empty())
             {
-                const Cell& sourceRow = sourceBox(sourceOffset.x, sourceOffset.y + y, sourceOffset.z + z);
-                Cell& targetRow = targetBox(targetOffset.x, targetOffset.y + y, targetOffset.z + z);
-                
-                memcpy(&targetRow, &sourceRow, size.x * sizeof(Cell));
+                begin = glm::min(begin, region.begin());
+                end = glm::max(end, region.end());
             }
+        }
+        
+        if (begin.x >= end.x)
+            return Region(chunkRegion.begin(), chunkRegion.begin());
+        
+        return Region(begin, end);
     }
     
-    Grid::Chunk::Chunk()
-    : box(kChunkSize, kChunkSize, kChunkSize)
+    static bool applyOperations(Chunk& chunk, const Region& chunkRegion, const Edit& edit)
     {
+        Region editRegion = getEditRegion(edit, chunkRegion);
+        
+        if (editRegion.empty())
+            return false;
+        
+        const glm::i32vec3& begin = editRegion.begin();
+        const glm::i32vec3& end = editRegion.end();
+        
+        bool changed = false;
+        
+        Cell row[kChunkSize];
+        Cell original[kChunkSize];
+        
+        // operations are applied in order to each row; rows are written back only if modified
+        for (int z = begin.z; z < end.z; ++z)
+            for (int y = begin.y; y < end.y; ++y)
+            {
+                glm::i32vec3 offset = glm::i32vec3(begin.x, y, z) - chunkRegion.begin();
+                unsigned int count = end.x - begin.x;
+                
+                chunk.read(row, offset.x, offset.y, offset.z, count);
+                memcpy(original, row, count * sizeof(Cell));
+                
+                for (auto& op: edit.getOperations())
+                {
+                    const glm::i32vec3& ob = op.region.begin();
+                    const glm::i32vec3& oe = op.region.end();
+                    
+                    if (y < ob.y || y >= oe.y || z < ob.z || z >= oe.z)
+                        continue;
+                    
+                    int x0 = std::max(ob.x, begin.x);
+                    int x1 = std::min(oe.x, end.x);
+                    
+                    if (x0 < x1)
+                        applyOperation(row + (x0 - begin.x), x1 - x0, glm::i32vec3(x0, y, z), op);
+                }
+                
+                if (memcmp(row, original, count * sizeof(Cell)) != 0)
+                {
+                    chunk.write(row, offset.x, offset.y, offset.z, count);
+                    changed = true;
+                }
+            }
+        
+        return changed;
     }
     
     Box Grid::read(const Region& region) const
     {
         Box result(region.size().x, region.size().y, region.size().z);
         
-        vector<glm::i32vec3> chunkIds = getChunkIds(region);
+        forEachChunk(region, [&](const glm::i32vec3& cid) {
+            if (const Chunk* chunk = findChunk(cid))
+                readCells(result, region, *chunk, getChunkRegion(cid));
+        });
         
-        for (auto cid: chunkIds)
-        {
-            auto cit = chunks.find(cid);
+        return result;
+    }
+    
+    Box Grid::read(const Region& region, unsigned int level) const
+    {
+        assert(level <= kChunkSizeLog2);
+        
+        if (level == 0)
+            return read(region);
+        
+        Box result(region.size().x, region.size().y, region.size().z);
+        
+        unsigned int size = kChunkSize >> level;
+        
+        forEachChunk(Region(region.begin() * (1 << level), region.end() * (1 << level)), [&](const glm::i32vec3& cid) {
+            const Chunk* chunk = findChunk(cid);
+            
+            // missing chunks read as empty cells
+            if (!chunk)
+                return;
+            
+            Region chunkRegion(cid * int(size), size);
+            Region target = chunkRegion.intersect(region);
+            
+            // level cells are point samples, so that every level shares sample positions with the finer ones
+            for (int z = target.begin().z; z < target.end().z; ++z)
+                for (int y = target.begin().y; y < target.end().y; ++y)
+                    for (int x = target.begin().x; x < target.end().x; ++x)
+                    {
+                        glm::i32vec3 p = (glm::i32vec3(x, y, z) - chunkRegion.begin()) * (1 << level);
+                        
+                        result.set(x - region.begin().x, y - region.begin().y, z - region.begin().z, chunk->get(p.x, p.y, p.z));
+                    }
+        });
+        
+        return result;
+    }
+    
+    void Grid::write(const Region& region, const Box& box)
+    {
+        assert(region.size() == glm::i32vec3(box.getWidth(), box.getHeight(), box.getDepth()));
+        
+        forEachChunk(region, [&](const glm::i32vec3& cid) {
+            modified.insert(cid);
             
-            if (cit != chunks.end())
+            if (Chunk* chunk = findChunk(cid))
+            {
+                writeCells(*chunk, getChunkRegion(cid), box, region);
+                
+                chunk->optimize();
+                
+                // missing chunks read as empty cells
+                if (isEmpty(*chunk))
+                    chunks.erase(cid);
+            }
+            else
+            {
+                Chunk newChunk;
+                
+                writeCells(newChunk, getChunkRegion(cid), box, region);
+                
+                newChunk.optimize();
+                
+                if (!isEmpty(newChunk))
+                    insertEntry(cid, move(newChunk));
+            }
+            
+            updateMips(cid, region);
+        });
+    }
+    
+    vector<glm::i32vec3> Grid::apply(const Edit& edit)
+    {
+        vector<glm::i32vec3> chunkIds;
+        
+        for (auto& op: edit.getOperations())
+            forEachChunk(op.region, [&](const glm::i32vec3& cid) { chunkIds.push_back(cid); });
+        
+        sort(chunkIds.begin(), chunkIds.end(), [](const glm::i32vec3& l, const glm::i32vec3& r) { return make_tuple(l.z, l.y, l.x) < make_tuple(r.z, r.y, r.x); });
+        chunkIds.erase(unique(chunkIds.begin(), chunkIds.end()), chunkIds.end());
+        
+        vector<glm::i32vec3> result;
+        
+        for (auto& cid: chunkIds)
+        {
+            if (Chunk* chunk = findChunk(cid))
             {
-                const Chunk& chunk = cit->second;
-                Region chunkRegion(cid << int(kChunkSizeLog2), kChunkSize);
+                if (applyOperations(*chunk, getChunkRegion(cid), edit))
+                {
+                    result.push_back(cid);
+                    modified.insert(cid);
+                    
+                    chunk->optimize();
+                    
+                    if (isEmpty(*chunk))
+                        chunks.erase(cid);
+                    
+                    updateMips(cid, getEditRegion(edit, getChunkRegion(cid)));
+                }
+            }
+            else
+            {
+                Chunk newChunk;
                 
-                copyCells(result, region, chunk.box, chunkRegion);
+                if (applyOperations(newChunk, getChunkRegion(cid), edit))
+                {
+                    result.push_back(cid);
+                    modified.insert(cid);
+                    
+                    newChunk.optimize();
+                    
+                    if (!isEmpty(newChunk))
+                        insertEntry(cid, move(newChunk));
+                    
+                    updateMips(cid, getEditRegion(edit, getChunkRegion(cid)));
+                }
             }
         }
         
         return result;
     }
     
-    void Grid::write(const Region& region, const Box& box)
+    optional<Cell> Grid::getUniformCell(const Region& region) const
     {
-        assert(region.size() == glm::i32vec3(box.getWidth(), box.getHeight(), box.getDepth()));
+        optional<Cell> result;
+        bool uniform = true;
+        
+        forEachChunk(region, [&](const glm::i32vec3& cid) {
+            const Chunk* chunk = findChunk(cid);
+            
+            if (chunk && !chunk->isUniform())
+            {
+                uniform = false;
+                return;
+            }
+            
+            Cell cell = chunk ? chunk->getUniformCell() : Cell { 0, 0 };
+            
+            if (result && (cell.occupancy != result->occupancy || cell.material != result->material))
+                uniform = false;
+            
+            result = cell;
+        });
+        
+        return uniform ? result : optional<Cell>();
+    }
+    
+    MipCell Grid::getMipCell(const glm::i32vec3& position, unsigned int level) const
+    {
+        assert(level <= kChunkSizeLog2);
+        
+        glm::i32vec3 cid = position >> int(kChunkSizeLog2 - level);
+        const ChunkMap::Entry* entry = findEntry(cid);
+        
+        if (!entry)
+            return MipCell { 0, 0 };
+        
+        const Chunk& chunk = entry->chunk;
+        
+        if (chunk.isUniform())
+            return MipCell { chunk.getUniformCell().occupancy, chunk.getUniformCell().occupancy };
+        
+        glm::i32vec3 p = position - cid * int(kChunkSize >> level);
+        
+        if (level == 0)
+        {
+            unsigned char occupancy = chunk.getOccupancy(p.x, p.y, p.z);
+            
+            return MipCell { occupancy, occupancy };
+        }
+        
+        assert(entry->mips);
+        
+        return entry->mips->get(level, p.x, p.y, p.z);
+    }
+    
+    vector<glm::i32vec3> Grid::getChunks() const
+    {
+        vector<glm::i32vec3> result;
+        result.reserve(chunks.size());
+        
+        for (auto& e: chunks)
+            result.push_back(e.id);
+        
+        for (auto& p: compressed)
+            result.push_back(p.first);
         
-        vector<glm::i32vec3> chunkIds = getChunkIds(region);
+        // stored chunks that were not paged in yet
+        if (store)
+            for (auto& id: store->getChunks())
+                if (!chunks.find(id) && !compressed.count(id) && !modified.count(id))
+                    result.push_back(id);
         
-        for (auto cid: chunkIds)
+        return result;
+    }
+    
+    bool Grid::hasChunk(const glm::i32vec3& id) const
+    {
+        if (chunks.find(id) || compressed.count(id))
+            return true;
+        
+        return store && !modified.count(id) && store->contains(id);
+    }
+    
+    size_t Grid::getMemoryUsage() const
+    {
+        size_t result = chunks.getMemoryUsage();
+        
+        for (auto& p: compressed)
+            result += sizeof(p) + p.second.data.capacity();
+        
+        return result;
+    }
+    
+    void Grid::setStore(ChunkStore* store)
+    {
+        this->store = store;
+    }
+    
+    void Grid::save()
+    {
+        assert(store);
+        
+        vector<pair<glm::i32vec3, vector<unsigned char>>> records;
+        
+        for (auto& id: modified)
+        {
+            auto it = compressed.find(id);
+            
+            if (const Chunk* chunk = chunks.find(id))
+            {
+                records.emplace_back(id, vector<unsigned char>());
+                encodeChunk(records.back().second, *chunk);
+            }
+            else if (it != compressed.end())
+            {
+                records.emplace_back(id, it->second.data);
+            }
+            else
+            {
+                store->erase(id);
+            }
+        }
+        
+        store->save(records);
+        
+        // saved chunks have fresh records, so earlier load failures no longer apply
+        for (auto& id: modified)
+            unreadable.erase(id);
+        
+        modified.clear();
+        
+        store->compact();
+    }
+    
+    void Grid::setMemoryBudget(size_t budget)
+    {
+        memoryBudget = budget;
+    }
+    
+    void Grid::trim()
+    {
+        // chunks accessed since the previous trim carry the current epoch and form the working set
+        unsigned int epoch = accessEpoch++;
+        
+        size_t usage = getMemoryUsage();
+        
+        if (usage <= memoryBudget)
+            return;
+        
+        vector<pair<unsigned int, glm::i32vec3>> candidates;
+        
+        // uniform chunks only cost a directory entry, so compressing them does not pay off
+        for (auto& e: chunks)
+            if (e.lastAccess < epoch && !e.chunk.isUniform())
+                candidates.emplace_back(e.lastAccess, e.id);
+        
+        sort(candidates.begin(), candidates.end(), [](const pair<unsigned int, glm::i32vec3>& l, const pair<unsigned int, glm::i32vec3>& r) { return l.first < r.first; });
+        
+        for (auto& c: candidates)
+        {
+            if (usage <= memoryBudget)
+                break;
+            
+            const ChunkMap::Entry* entry = chunks.findEntry(c.second);
+            
+            CompressedChunk& result = compressed[c.second];
+            
+            encodeChunk(result.data, entry->chunk);
+            result.data.shrink_to_fit();
+            result.lastAccess = c.first;
+            
+            usage -= entry->chunk.getMemoryUsage() - sizeof(Chunk) + (entry->mips ? sizeof(ChunkMips) : 0);
+            usage += sizeof(pair<const glm::i32vec3, CompressedChunk>) + result.data.capacity();
+            
+            chunks.erase(c.second);
+            
+            stats.compressions++;
+        }
+        
+        // without a store compressed chunks are the last tier
+        if (!store || usage <= memoryBudget)
+            return;
+        
+        candidates.clear();
+        
+        for (auto& p: compressed)
+            candidates.emplace_back(p.second.lastAccess, p.first);
+        
+        sort(candidates.begin(), candidates.end(), [](const pair<unsigned int, glm::i32vec3>& l, const pair<unsigned int, glm::i32vec3>& r) { return l.first < r.first; });
+        
+        vector<glm::i32vec3> evicted;
+        vector<pair<glm::i32vec3, vector<unsigned char>>> records;
+        
+        for (auto& c: candidates)
+        {
+            if (usage <= memoryBudget)
+                break;
+            
+            auto it = compressed.find(c.second);
+            
+            // unmodified chunks are already in the store; the record format matches, so modified ones are written as is
+            if (modified.count(c.second))
+                records.emplace_back(c.second, it->second.data);
+            
+            usage -= sizeof(*it) + it->second.data.capacity();
+            
+            evicted.push_back(c.second);
+        }
+        
+        // evicted chunks are written in one batch that syncs each region file once; they stay resident if that fails,
+        // and region files are only compacted by save since trim runs every frame
+        if (!records.empty())
+        {
+            try
+            {
+                store->save(records);
+            }
+            catch (const exception& e)
+            {
+                fprintf(stderr, "Failed to evict chunks: %s\n", e.what());
+                return;
+            }
+        }
+        
+        for (auto& id: evicted)
+        {
+            if (modified.erase(id))
+                unreadable.erase(id);
+            compressed.erase(id);
+            
+            stats.evictions++;
+        }
+    }
+    
+    GridStats Grid::getStats() const
+    {
+        GridStats result = stats;
+        
+        result.denseChunks = chunks.size();
+        result.compressedChunks = compressed.size();
+        result.memoryUsage = getMemoryUsage();
+        
+        return result;
+    }
+    
+    void Grid::setChunkLayout(Chunk::Layout layout)
+    {
+        chunkLayout = layout;
+        
+        for (auto& e: chunks)
+            e.chunk.setLayout(layout);
+    }
+    
+    ChunkMap::Entry* Grid::findEntry(const glm::i32vec3& id) const
+    {
+        if (ChunkMap::Entry* entry = chunks.findEntry(id))
         {
-            Chunk& chunk = chunks[cid];
-            Region chunkRegion(cid << int(kChunkSizeLog2), kChunkSize);
+            entry->lastAccess = accessEpoch;
+            stats.hits++;
+            
+            return entry;
+        }
+        
+        Chunk chunk;
+        
+        auto it = compressed.find(id);
+        
+        if (it != compressed.end())
+        {
+            bool result = decodeChunk(chunk, it->second.data.data(), it->second.data.size());
+            assert(result);
+            (void)result;
+            
+            compressed.erase(it);
+            
+            stats.decompressions++;
+        }
+        else
+        {
+            // modified chunks are up to date in memory, so a missing one was erased since the last save
+            if (!store || modified.count(id) || unreadable.count(id))
+                return nullptr;
+            
+            // reads can happen anywhere in a frame, so a bad record reads as a missing chunk instead of throwing;
+            // it is reported once and skipped until the chunk is saved again
+            try
+            {
+                if (!store->load(id, chunk))
+                    return nullptr;
+            }
+            catch (const exception& e)
+            {
+                fprintf(stderr, "Failed to load chunk %d %d %d: %s\n", id.x, id.y, id.z, e.what());
+                
+                unreadable.insert(id);
+                return nullptr;
+            }
             
-            copyCells(chunk.box, chunkRegion, box, region);
+            stats.loads++;
+        }
+        
+        ChunkMap::Entry& result = insertEntry(id, move(chunk));
+        
+        if (!result.chunk.isUniform())
+        {
+            result.mips = make_unique<ChunkMips>();
+            result.mips->update(result.chunk, Region(glm::i32vec3(0), kChunkSize));
+        }
+        
+        return &result;
+    }
+    
+    ChunkMap::Entry& Grid::insertEntry(const glm::i32vec3& id, Chunk&& chunk) const
+    {
+        chunk.setLayout(chunkLayout);
+        
+        chunks[id] = move(chunk);
+        
+        ChunkMap::Entry* entry = chunks.findEntry(id);
+        entry->lastAccess = accessEpoch;
+        
+        return *entry;
+    }
+    
+    Chunk* Grid::findChunk(const glm::i32vec3& id) const
+    {
+        ChunkMap::Entry* entry = findEntry(id);
+        
+        return entry ? &entry->chunk : nullptr;
+    }
+    
+    void Grid::updateMips(const glm::i32vec3& id, const Region& region)
+    {
+        ChunkMap::Entry* entry = chunks.findEntry(id);
+        
+        // erased chunks take their mips with them
+        if (!entry)
+            return;
+        
+        if (entry->chunk.isUniform())
+        {
+            entry->mips.reset();
+            return;
+        }
+        
+        Region chunkRegion = getChunkRegion(id);
+        Region localRegion = region.intersect(chunkRegion);
+        
+        // chunks that just stopped being uniform need all mips; others only the ones covering the modified cells
+        if (!entry->mips)
+        {
+            entry->mips = make_unique<ChunkMips>();
+            entry->mips->update(entry->chunk, Region(glm::i32vec3(0), kChunkSize));
+        }
+        else
+        {
+            entry->mips->update(entry->chunk, Region(localRegion.begin() - chunkRegion.begin(), localRegion.end() - chunkRegion.begin()));
         }
     }
 }
\ No newline at end of file
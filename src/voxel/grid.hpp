@@ -1,87 +1,106 @@
 #pragma once
 
+#include "voxel/box.hpp"
+#include "voxel/chunkmap.hpp"
+#include "voxel/chunkmips.hpp"
+
 namespace voxel
 {
-    struct Cell
+    class Edit;
+    class ChunkStore;
+    
+    // Chunk cache counters; lookups are counted per chunk access, and sizes reflect the last call
+    struct GridStats
     {
-        unsigned char occupancy;
-        unsigned char material;
+        size_t hits;
+        size_t decompressions;
+        size_t loads;
+        size_t compressions;
+        size_t evictions;
+        
+        size_t denseChunks;
+        size_t compressedChunks;
+        size_t memoryUsage;
     };
     
-    class Region
+    class Grid
     {
     public:
-        Region(const glm::i32vec3& begin, const glm::i32vec3& end)
-        : begin_(begin)
-        , end_(end)
-        {
-            assert(begin.x <= end.x && begin.y <= end.y && begin.z <= end.z);
-        }
+        static Region getChunkRegion(const glm::i32vec3& id);
+        static vector<glm::i32vec3> getChunkIds(const Region& region);
         
-        Region(const glm::i32vec3& begin, unsigned int size)
-        : begin_(begin)
-        , end_(begin + int(size))
-        {
-        }
+        Box read(const Region& region) const;
         
-        const glm::i32vec3& begin() const { return begin_; }
-        const glm::i32vec3& end() const { return end_; }
+        // Reads every 2^level-th cell along each axis; region is in level cells, so level cell p is cell p * 2^level
+        Box read(const Region& region, unsigned int level) const;
         
-        glm::i32vec3 size() const { return end_ - begin_; }
- 
-        bool empty() const { return begin_.x == end_.x || begin_.y == end_.y || begin_.z == end_.z; }
+        void write(const Region& region, const Box& box);
         
-        Region intersect(const Region& other) const;
-    
-    private:
-        glm::i32vec3 begin_;
-        glm::i32vec3 end_;
-    };
-    
-    class Box
-    {
-    public:
-        Box(unsigned int width, unsigned int height, unsigned int depth);
+        // Applies all operations chunk by chunk and returns ids of chunks with modified cells
+        vector<glm::i32vec3> apply(const Edit& edit);
         
-        Cell& operator()(unsigned int x, unsigned int y, unsigned int z)
-        {
-            assert(x < width && y < height && z < depth);
-            return data[x + width * y + slice * z];
-        }
+        // Returns the cell value if all cells in the region are the same
+        optional<Cell> getUniformCell(const Region& region) const;
         
-        const Cell& operator()(unsigned int x, unsigned int y, unsigned int z) const
-        {
-            assert(x < width && y < height && z < depth);
-            return data[x + width * y + slice * z];
-        }
+        // Returns mean and max occupancy of the 2^level cube at a level cell; mips are kept up to date by writes
+        MipCell getMipCell(const glm::i32vec3& position, unsigned int level) const;
         
-        unsigned int getWidth() const { return width; }
-        unsigned int getHeight() const { return height; }
-        unsigned int getDepth() const { return depth; }
+        vector<glm::i32vec3> getChunks() const;
         
-    private:
-        unsigned int width;
-        unsigned int height;
-        unsigned int depth;
-        unsigned int slice;
+        // Returns true if the chunk is resident, compressed or stored; never pages the chunk in
+        bool hasChunk(const glm::i32vec3& id) const;
+        const Chunk* getChunk(const glm::i32vec3& id) const { return findChunk(id); }
         
-        unique_ptr<Cell[]> data;
-    };
-    
-    class Grid
-    {
-    public:
-        Box read(const Region& region) const;
-        void write(const Region& region, const Box& box);
+        size_t getMemoryUsage() const;
+        
+        // Pages stored chunks in on first access; set before the grid is used. Modified chunks are written back by save,
+        // which also compacts region files once stale records outweigh live ones
+        void setStore(ChunkStore* store);
+        void save();
+        
+        // Chunks not accessed since the previous trim are compressed in place when the grid exceeds the budget,
+        // and compressed chunks are evicted to the store oldest first; trim invalidates grid views and chunk pointers
+        void setMemoryBudget(size_t budget);
+        void trim();
+        
+        GridStats getStats() const;
+        
+        // Sets the dense storage layout of all chunks, including the ones paged in later
+        void setChunkLayout(Chunk::Layout layout);
     
     private:
-        struct Chunk
+        struct CompressedChunk
         {
-            Box box;
-            
-            Chunk();
+            vector<unsigned char> data;
+            unsigned int lastAccess;
         };
         
-        unordered_map<glm::i32vec3, Chunk> chunks;
+        ChunkMap::Entry* findEntry(const glm::i32vec3& id) const;
+        ChunkMap::Entry& insertEntry(const glm::i32vec3& id, Chunk&& chunk) const;
+        
+        Chunk* findChunk(const glm::i32vec3& id) const;
+        
+        void updateMips(const glm::i32vec3& id, const Region& region);
+        
+        // chunks are paged in through const accessors too, so the resident set is mutable
+        mutable ChunkMap chunks;
+        
+        ChunkStore* store = nullptr;
+        
+        // chunks that differ from the store, including erased ones
+        unordered_set<glm::i32vec3> modified;
+        
+        // stored chunks that failed to load; they read as missing until saved again
+        mutable unordered_set<glm::i32vec3> unreadable;
+        
+        // chunks are expanded on first access, so the compressed set is mutable as well
+        mutable unordered_map<glm::i32vec3, CompressedChunk> compressed;
+        
+        Chunk::Layout chunkLayout = Chunk::Layout_Linear;
+        
+        size_t memoryBudget = ~size_t(0);
+        unsigned int accessEpoch = 1;
+        
+        mutable GridStats stats = {};
     };
 }
\ No newline at end of file
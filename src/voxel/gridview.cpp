@@ -0,0 +1,178 @@
+#include "common.hpp"
+#include "voxel/gridview.hpp"
+
+namespace voxel
+{
+    static const unsigned char kEmptyRow[kChunkSize] = {};
+    
+    GridView::Offsets GridView::getOffsets(Chunk::Layout layout, bool row)
+    {
+        Offsets result;
+        
+        for (unsigned int i = 0; i < kChunkSize; ++i)
+        {
+            if (row)
+            {
+                result.x[i] = i;
+                result.y[i] = 0;
+                result.z[i] = 0;
+            }
+            else if (layout == Chunk::Layout_Bricked)
+            {
+                result.x[i] = Chunk::getBrickedIndex(i, 0, 0);
+                result.y[i] = Chunk::getBrickedIndex(0, i, 0);
+                result.z[i] = Chunk::getBrickedIndex(0, 0, i);
+            }
+            else
+            {
+                result.x[i] = i;
+                result.y[i] = i * kChunkSize;
+                result.z[i] = i * kChunkSize * kChunkSize;
+            }
+        }
+        
+        result.rowLength = (layout == Chunk::Layout_Bricked && !row) ? kChunkBrickSize : kChunkSize;
+        
+        return result;
+    }
+    
+    // uniform and empty chunks are a single row repeated along y and z
+    const GridView::Offsets GridView::kRowOffsets = GridView::getOffsets(Chunk::Layout_Linear, true);
+    const GridView::Offsets GridView::kLinearOffsets = GridView::getOffsets(Chunk::Layout_Linear, false);
+    const GridView::Offsets GridView::kBrickedOffsets = GridView::getOffsets(Chunk::Layout_Bricked, false);
+    
+    GridView::GridView(const Grid& grid, const Region& region)
+    : region(region)
+    , width(region.size().x)
+    , height(region.size().y)
+    , depth(region.size().z)
+    , blocksX(0)
+    , blocksY(0)
+    , originOccupancy(nullptr)
+    , originMaterial(nullptr)
+    , strideY(0)
+    , strideZ(0)
+    {
+        if (region.empty())
+            return;
+        
+        glm::i32vec3 min = region.begin() >> int(kChunkSizeLog2);
+        glm::i32vec3 max = (region.end() - 1) >> int(kChunkSizeLog2);
+        
+        offset = region.begin() - min * int(kChunkSize);
+        
+        blocksX = max.x - min.x + 1;
+        blocksY = max.y - min.y + 1;
+        blocks.reserve(blocksX * blocksY * (max.z - min.z + 1));
+        
+        for (int z = min.z; z <= max.z; ++z)
+            for (int y = min.y; y <= max.y; ++y)
+                for (int x = min.x; x <= max.x; ++x)
+                {
+                    glm::i32vec3 cid(x, y, z);
+                    const Chunk* chunk = grid.getChunk(cid);
+                    
+                    if (!chunk)
+                    {
+                        blocks.push_back(Block { kEmptyRow, kEmptyRow, &kRowOffsets });
+                    }
+                    else if (chunk->isUniform())
+                    {
+                        unsigned char* rows = new unsigned char[kChunkSize * 2];
+                        storage.emplace_back(rows);
+                        
+                        memset(rows, chunk->getUniformCell().occupancy, kChunkSize);
+                        memset(rows + kChunkSize, chunk->getUniformCell().material, kChunkSize);
+                        
+                        blocks.push_back(Block { rows, rows + kChunkSize, &kRowOffsets });
+                    }
+                    else if (chunk->getOccupancyData())
+                    {
+                        blocks.push_back(Block { chunk->getOccupancyData(), chunk->getMaterialData(), chunk->getLayout() == Chunk::Layout_Bricked ? &kBrickedOffsets : &kLinearOffsets });
+                    }
+                    else
+                    {
+                        // decode the cells that intersect the view into a buffer sized to the intersection
+                        Region chunkRegion = Grid::getChunkRegion(cid);
+                        Region part = chunkRegion.intersect(region);
+                        
+                        glm::i32vec3 begin = part.begin() - chunkRegion.begin();
+                        glm::i32vec3 size = part.size();
+                        unsigned int cells = size.x * size.y * size.z;
+                        
+                        unsigned char* decoded = new unsigned char[cells * 2];
+                        storage.emplace_back(decoded);
+                        
+                        for (int cz = 0; cz < size.z; ++cz)
+                            for (int cy = 0; cy < size.y; ++cy)
+                            {
+                                unsigned int index = size.x * (cy + size.y * cz);
+                                
+                                chunk->read(&decoded[index], &decoded[cells + index], begin.x, begin.y + cy, begin.z + cz, size.x);
+                            }
+                        
+                        // offsets are relative to the start of the intersection; cells outside of it are never addressed
+                        Offsets* offsets = new Offsets();
+                        partOffsets.emplace_back(offsets);
+                        
+                        for (unsigned int i = 0; i < kChunkSize; ++i)
+                        {
+                            offsets->x[i] = i - begin.x;
+                            offsets->y[i] = (i - begin.y) * size.x;
+                            offsets->z[i] = (i - begin.z) * size.x * size.y;
+                        }
+                        
+                        offsets->rowLength = kChunkSize;
+                        
+                        blocks.push_back(Block { decoded, decoded + cells, offsets });
+                    }
+                }
+        
+        // single linear chunks are addressed with strides; bricked ones go through the offsets
+        if (blocks.size() == 1 && blocks[0].offsets != &kBrickedOffsets)
+        {
+            const Block& block = blocks[0];
+            unsigned int index = block.offsets->x[offset.x] + block.offsets->y[offset.y] + block.offsets->z[offset.z];
+            
+            originOccupancy = block.occupancy + index;
+            originMaterial = block.material + index;
+            strideY = block.offsets->y[1] - block.offsets->y[0];
+            strideZ = block.offsets->z[1] - block.offsets->z[0];
+        }
+    }
+    
+    const unsigned char* GridView::getOccupancyRow(unsigned int x, unsigned int y, unsigned int z, unsigned int& count) const
+    {
+        unsigned int index;
+        const Block& block = getRowBlock(x, y, z, count, index);
+        
+        return block.occupancy + index;
+    }
+    
+    const unsigned char* GridView::getMaterialRow(unsigned int x, unsigned int y, unsigned int z, unsigned int& count) const
+    {
+        unsigned int index;
+        const Block& block = getRowBlock(x, y, z, count, index);
+        
+        return block.material + index;
+    }
+    
+    const GridView::Block& GridView::getRowBlock(unsigned int x, unsigned int y, unsigned int z, unsigned int& count, unsigned int& index) const
+    {
+        assert(x < width && y < height && z < depth);
+        
+        unsigned int px = x + offset.x;
+        unsigned int py = y + offset.y;
+        unsigned int pz = z + offset.z;
+        
+        const Block& block = blocks[(px >> kChunkSizeLog2) + blocksX * ((py >> kChunkSizeLog2) + blocksY * (pz >> kChunkSizeLog2))];
+        const Offsets& offsets = *block.offsets;
+        
+        unsigned int lx = px & (kChunkSize - 1);
+        
+        count = min(min(count, width - x), offsets.rowLength - (lx & (offsets.rowLength - 1)));
+        index = offsets.x[lx] + offsets.y[py & (kChunkSize - 1)] + offsets.z[pz & (kChunkSize - 1)];
+        
+        return block;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "voxel/grid.hpp"
+
+namespace voxel
+{
+    // Read-only view of a grid region that references chunk storage in place where possible;
+    // the view is invalidated by any write to the grid
+    class GridView: noncopyable
+    {
+    public:
+        GridView(const Grid& grid, const Region& region);
+        
+        Cell operator()(unsigned int x, unsigned int y, unsigned int z) const
+        {
+            assert(x < width && y < height && z < depth);
+            
+            // region inside a single chunk
+            if (originOccupancy)
+            {
+                unsigned int index = x + strideY * y + strideZ * z;
+                
+                return Cell { originOccupancy[index], originMaterial[index] };
+            }
+            
+            unsigned int px = x + offset.x;
+            unsigned int py = y + offset.y;
+            unsigned int pz = z + offset.z;
+            
+            const Block& block = blocks[(px >> kChunkSizeLog2) + blocksX * ((py >> kChunkSizeLog2) + blocksY * (pz >> kChunkSizeLog2))];
+            const Offsets& offsets = *block.offsets;
+            
+            unsigned int index = offsets.x[px & (kChunkSize - 1)] + offsets.y[py & (kChunkSize - 1)] + offsets.z[pz & (kChunkSize - 1)];
+            
+            return Cell { block.occupancy[index], block.material[index] };
+        }
+        
+        // Returns the occupancy of one cell, for sweeps that ignore material
+        unsigned char getOccupancy(unsigned int x, unsigned int y, unsigned int z) const
+        {
+            assert(x < width && y < height && z < depth);
+            
+            if (originOccupancy)
+                return originOccupancy[x + strideY * y + strideZ * z];
+            
+            unsigned int px = x + offset.x;
+            unsigned int py = y + offset.y;
+            unsigned int pz = z + offset.z;
+            
+            const Block& block = blocks[(px >> kChunkSizeLog2) + blocksX * ((py >> kChunkSizeLog2) + blocksY * (pz >> kChunkSizeLog2))];
+            const Offsets& offsets = *block.offsets;
+            
+            return block.occupancy[offsets.x[px & (kChunkSize - 1)] + offsets.y[py & (kChunkSize - 1)] + offsets.z[pz & (kChunkSize - 1)]];
+        }
+        
+        // Return contiguous plane values starting at (x, y, z); count is clamped to the end of the containing chunk or brick
+        const unsigned char* getOccupancyRow(unsigned int x, unsigned int y, unsigned int z, unsigned int& count) const;
+        const unsigned char* getMaterialRow(unsigned int x, unsigned int y, unsigned int z, unsigned int& count) const;
+        
+        const Region& getRegion() const { return region; }
+        
+        unsigned int getWidth() const { return width; }
+        unsigned int getHeight() const { return height; }
+        unsigned int getDepth() const { return depth; }
+        
+    private:
+        // Cell offsets per axis for a chunk layout; rows are contiguous for rowLength cells
+        struct Offsets
+        {
+            unsigned int x[kChunkSize];
+            unsigned int y[kChunkSize];
+            unsigned int z[kChunkSize];
+            unsigned int rowLength;
+        };
+        
+        struct Block
+        {
+            const unsigned char* occupancy;
+            const unsigned char* material;
+            const Offsets* offsets;
+        };
+        
+        const Block& getRowBlock(unsigned int x, unsigned int y, unsigned int z, unsigned int& count, unsigned int& index) const;
+        
+        static Offsets getOffsets(Chunk::Layout layout, bool row);
+        
+        static const Offsets kRowOffsets;
+        static const Offsets kLinearOffsets;
+        static const Offsets kBrickedOffsets;
+        
+        Region region;
+        
+        unsigned int width;
+        unsigned int height;
+        unsigned int depth;
+        
+        glm::i32vec3 offset;
+        
+        unsigned int blocksX;
+        unsigned int blocksY;
+        vector<Block> blocks;
+        
+        const unsigned char* originOccupancy;
+        const unsigned char* originMaterial;
+        unsigned int strideY;
+        unsigned int strideZ;
+        
+        vector<unique_ptr<unsigned char[]>> storage;
+        vector<unique_ptr<Offsets>> partOffsets;
+    };
+}
\ No newline at end of file
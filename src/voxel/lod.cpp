@@ -0,0 +1,89 @@
+#include "common.hpp"
+#include "voxel/lod.hpp"
+
+#include "voxel/grid.hpp"
+
+namespace voxel
+{
+    Region getLevelRegion(const Region& region, unsigned int level)
+    {
+        if (region.empty())
+            return Region(region.begin() >> int(level), region.begin() >> int(level));
+        
+        return Region(region.begin() >> int(level), ((region.end() - 1) >> int(level)) + 1);
+    }
+    
+    Region getLodNodeRegion(const LodNode& node)
+    {
+        return Grid::getChunkRegion(node.id);
+    }
+    
+    Region getLodNodeBounds(const LodNode& node)
+    {
+        Region region = getLodNodeRegion(node);
+        
+        return Region(region.begin() * (1 << node.level), region.end() * (1 << node.level));
+    }
+    
+    static float getDistance(const Region& bounds, const vec3& position)
+    {
+        vec3 closest = glm::clamp(position, vec3(bounds.begin()), vec3(bounds.end()));
+        
+        return glm::distance(closest, position);
+    }
+    
+    static void selectLodNodesRec(vector<LodNode>& result, const LodNode& node, const Region& region, const vec3& position, float detail)
+    {
+        Region bounds = getLodNodeBounds(node);
+        
+        if (node.level == 0 || getDistance(bounds, position) >= detail * bounds.size().x)
+        {
+            result.push_back(node);
+            return;
+        }
+        
+        for (int i = 0; i < 8; ++i)
+        {
+            LodNode child = { node.id * 2 + glm::i32vec3(i & 1, (i >> 1) & 1, i >> 2), node.level - 1 };
+            
+            if (!getLodNodeBounds(child).intersect(region).empty())
+                selectLodNodesRec(result, child, region, position, detail);
+        }
+    }
+    
+    vector<LodNode> selectLodNodes(const Region& region, const vec3& position, float detail, unsigned int maxLevel)
+    {
+        vector<LodNode> result;
+        
+        for (auto& id: Grid::getChunkIds(getLevelRegion(region, maxLevel)))
+            selectLodNodesRec(result, LodNode { id, maxLevel }, region, position, detail);
+        
+        return result;
+    }
+    
+    unsigned int getLodTransitionFaces(const unordered_set<LodNode>& nodes, const LodNode& node)
+    {
+        if (node.level == 0)
+            return 0;
+        
+        unsigned int result = 0;
+        
+        for (int face = 0; face < 6; ++face)
+        {
+            int axis = face >> 1;
+            int side = face & 1;
+            
+            glm::i32vec3 neighbour = node.id;
+            neighbour[axis] += side ? 1 : -1;
+            
+            // the cut is balanced, so a neighbour child next to the face is in the cut if the neighbour was split
+            glm::i32vec3 child = neighbour * 2;
+            child[axis] += side ? 0 : 1;
+            
+            if (nodes.count(LodNode { child, node.level - 1 }))
+                result |= 1 << face;
+        }
+        
+        return result;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "voxel/box.hpp"
+
+namespace voxel
+{
+    // Octree node covering kChunkSize^3 cells of the given level; level 0 nodes are grid chunks
+    struct LodNode
+    {
+        glm::i32vec3 id;
+        unsigned int level;
+        
+        bool operator==(const LodNode& other) const { return id == other.id && level == other.level; }
+        bool operator!=(const LodNode& other) const { return !(*this == other); }
+    };
+}
+
+namespace std
+{
+    template <> struct hash<voxel::LodNode>
+    {
+        size_t operator()(const voxel::LodNode& node) const noexcept
+        {
+            return hash_combine(hash_value(node.id), hash_value(node.level));
+        }
+    };
+}
+
+namespace voxel
+{
+    // Converts a region of cells to the level cells that overlap it
+    Region getLevelRegion(const Region& region, unsigned int level);
+    
+    // Returns node region in level cells and in level 0 cells respectively
+    Region getLodNodeRegion(const LodNode& node);
+    Region getLodNodeBounds(const LodNode& node);
+    
+    // Selects an octree cut over the region; nodes closer to position than detail * node size are split,
+    // and detail of 1 or more keeps face neighbours within one level of each other
+    vector<LodNode> selectLodNodes(const Region& region, const vec3& position, float detail, unsigned int maxLevel);
+    
+    // Returns faces of the node that border finer nodes of the cut, as MeshOptions::transitionFaces
+    unsigned int getLodTransitionFaces(const unordered_set<LodNode>& nodes, const LodNode& node);
+}
\ No newline at end of file
@@ -3,6 +3,10 @@
 namespace voxel
 {
     class Box;
+    class GridView;
+    
+    // Occupancy at which the meshers extract the surface and raycasts hit it, in occupancy units (0..255)
+    const float kIsolevel = 0.5f;
     
     struct MeshVertex
     {
@@ -12,6 +16,23 @@ namespace voxel
     
     struct MeshOptions
     {
+        // Emits four vertices per quad with normals bent towards the quad normal (surface nets only)
+        bool blendQuadNormals = false;
+        
+        // Faces that border cells of twice the resolution, as bits 1 << (axis * 2 + side) with side 1 at the far end (marching cubes only);
+        // cells next to these faces shrink and transition cells join them to the fine surface without cracks
+        unsigned int transitionFaces = 0;
+        
+        // Cells at twice the resolution for transition faces; cell (x, y, z) samples box position ((x, y, z) - 1) / 2,
+        // and the box spans one fine cell past the meshed cells on every side
+        const Box* transitionBox = nullptr;
+    };
+    
+    // Number of cells the mesher needs around the meshed cells to produce a seamless mesh
+    struct MeshBorder
+    {
+        int before;
+        int after;
     };
     
     class Mesher
@@ -19,7 +40,10 @@ namespace voxel
     public:
         virtual ~Mesher() {}
         
+        virtual MeshBorder getBorder() const = 0;
+        
         virtual pair<vector<MeshVertex>, vector<unsigned int>> generate(const Box& box, const vec3& offset, float cellSize, const MeshOptions& options) = 0;
+        virtual pair<vector<MeshVertex>, vector<unsigned int>> generate(const GridView& view, const vec3& offset, float cellSize, const MeshOptions& options) = 0;
     };
     
     unique_ptr<Mesher> createMesherSurfaceNets();
@@ -2,6 +2,8 @@
 #include "voxel/mesher.hpp"
 
 #include "voxel/grid.hpp"
+#include "voxel/gridview.hpp"
+#include "voxel/cubeindex.hpp"
 
 namespace voxel
 {
@@ -336,12 +338,77 @@ namespace voxel
             float iso;
             float nx, ny, nz;
         };
-
+        
+        // cell offset and axis of the grid edge each cube edge lies on
+        static const unsigned char kEdgeCacheTable[][4] =
+        {
+            {0, 0, 0, 0},
+            {1, 0, 0, 1},
+            {0, 1, 0, 0},
+            {0, 0, 0, 1},
+            {0, 0, 1, 0},
+            {1, 0, 1, 1},
+            {0, 1, 1, 0},
+            {0, 0, 1, 1},
+            {0, 0, 0, 2},
+            {1, 0, 0, 2},
+            {1, 1, 0, 2},
+            {0, 1, 0, 2}
+        };
+        
+        static const unsigned int kEmptyEdge = ~0u;
+        
+        // Vertex indices for grid edges of the current slab, so that neighbouring cubes share edge vertices;
+        // cells are in finest subdivision units and the slab covers depth - 1 cell layers
+        class EdgeCache
+        {
+        public:
+            EdgeCache(unsigned int sizeX, unsigned int sizeY, unsigned int depth)
+            : sizeX(sizeX)
+            , sizeY(sizeY)
+            , depth(depth)
+            , baseZ(0)
+            , data(new unsigned int[sizeX * sizeY * depth * 3])
+            {
+                fill(data.get(), data.get() + sizeX * sizeY * depth * 3, kEmptyEdge);
+            }
+            
+            unsigned int& get(const glm::i32vec3& cell, int edge)
+            {
+                const unsigned char* e = kEdgeCacheTable[edge];
+                
+                unsigned int x = cell.x + e[0];
+                unsigned int y = cell.y + e[1];
+                unsigned int z = cell.z + e[2] - baseZ;
+                assert(x < sizeX && y < sizeY && z < depth);
+                
+                return data[e[3] + 3 * (x + sizeX * (y + sizeY * z))];
+            }
+            
+            // Moves to the next slab; the last plane of edges is shared with it
+            void advance()
+            {
+                unsigned int plane = sizeX * sizeY * 3;
+                
+                copy(data.get() + plane * (depth - 1), data.get() + plane * depth, data.get());
+                fill(data.get() + plane, data.get() + plane * depth, kEmptyEdge);
+                
+                baseZ += depth - 1;
+            }
+            
+        private:
+            unsigned int sizeX;
+            unsigned int sizeY;
+            unsigned int depth;
+            unsigned int baseZ;
+            unique_ptr<unsigned int[]> data;
+        };
+        
         template <int Lod>
         struct CubeGenerator
         {
             static void generate(
-                vector<MeshVertex>& vb, vector<unsigned int>& ib,
+                vector<MeshVertex>& vb, vector<unsigned int>& ib, EdgeCache& cache, const glm::i32vec3& cell,
                 const GridVertex& v000, const GridVertex& v100, const GridVertex& v110, const GridVertex& v010,
                 const GridVertex& v001, const GridVertex& v101, const GridVertex& v111, const GridVertex& v011,
                 float isolevel, const vec3& offset, float scale)
@@ -401,7 +468,7 @@ namespace voxel
                         for (int y = 0; y < 2; ++y)
                             for (int x = 0; x < 2; ++x)
                             {
-                                CubeGenerator<Lod-1>::generate(vb, ib,
+                                CubeGenerator<Lod-1>::generate(vb, ib, cache, cell + glm::i32vec3(x, y, z) * (1 << (Lod - 1)),
                                                                tgrid[z+0][y+0][x+0],
                                                                tgrid[z+0][y+0][x+1],
                                                                tgrid[z+0][y+1][x+1],
@@ -422,7 +489,7 @@ namespace voxel
         struct CubeGenerator<0>
         {
             static void generate(
-                vector<MeshVertex>& vb, vector<unsigned int>& ib,
+                vector<MeshVertex>& vb, vector<unsigned int>& ib, EdgeCache& cache, const glm::i32vec3& cell,
                 const GridVertex& v000, const GridVertex& v100, const GridVertex& v110, const GridVertex& v010,
                 const GridVertex& v001, const GridVertex& v101, const GridVertex& v111, const GridVertex& v011,
                 float isolevel, const vec3& offset, float scale)
@@ -462,7 +529,15 @@ namespace voxel
                     {
                         if (edgemask & (1 << i))
                         {
-                            edges[i] = vb.size();
+                            unsigned int& cached = cache.get(cell, i);
+                            
+                            if (cached != kEmptyEdge)
+                            {
+                                edges[i] = cached;
+                                continue;
+                            }
+                            
+                            edges[i] = cached = vb.size();
                             
                             int e0 = kEdgeIndexTable[i][0];
                             int e1 = kEdgeIndexTable[i][1];
@@ -507,101 +582,570 @@ namespace voxel
             }
         };
         
-        class Mesher: public voxel::Mesher
+        // Surface boundary on each cube face as pairs of cube edges in triangle winding order; the surface inside is to the left
+        // of each pair when the face is seen from outside the cube
+        struct FaceSegments
         {
-            pair<vector<MeshVertex>, vector<unsigned int>> generate(const Box& box, const vec3& offset, float cellSize, const MeshOptions& options) override
+            unsigned char count;
+            unsigned char edges[2][2];
+        };
+        
+        static int getEdgeFace(int e0, int e1)
+        {
+            for (int face = 0; face < 6; ++face)
             {
-                const int lod = 0;
-                const bool estimateNormals = false;
-                const float isolevel = 0.5f / 255.f;
+                int axis = face >> 1;
+                int side = face & 1;
                 
-                unsigned int sizeX = box.getWidth(), sizeY = box.getHeight(), sizeZ = box.getDepth();
-                assert(sizeX > 2 && sizeY > 2 && sizeZ > 2);
-                
-                unique_ptr<GridVertex[]> grid(new GridVertex[(sizeX - 1) * (sizeY - 1) * (sizeZ - 1)]);
-                
-                for (int z = 0; z < sizeZ - 1; ++z)
-                    for (int y = 0; y < sizeY - 1; ++y)
-                        for (int x = 0; x < sizeX - 1; ++x)
+                if (kVertexIndexTable[kEdgeIndexTable[e0][0]][axis] == side && kVertexIndexTable[kEdgeIndexTable[e0][1]][axis] == side &&
+                    kVertexIndexTable[kEdgeIndexTable[e1][0]][axis] == side && kVertexIndexTable[kEdgeIndexTable[e1][1]][axis] == side)
+                    return face;
+            }
+            
+            return -1;
+        }
+        
+        static int getCornerEdge(int c0, int c1)
+        {
+            for (int i = 0; i < 12; ++i)
+                if ((kEdgeIndexTable[i][0] == c0 && kEdgeIndexTable[i][1] == c1) || (kEdgeIndexTable[i][0] == c1 && kEdgeIndexTable[i][1] == c0))
+                    return i;
+            
+            return -1;
+        }
+        
+        static int getCorner(const glm::i32vec3& p)
+        {
+            for (int i = 0; i < 8; ++i)
+                if (kVertexIndexTable[i][0] == p.x && kVertexIndexTable[i][1] == p.y && kVertexIndexTable[i][2] == p.z)
+                    return i;
+            
+            return -1;
+        }
+        
+        // Triangle edges that lie on a cube face, collected from the triangle table so that transition cells match it exactly
+        struct FaceSegmentTable
+        {
+            FaceSegments cases[256][6] = {};
+            
+            FaceSegmentTable()
+            {
+                for (int i = 0; i < 256; ++i)
+                    for (int t = 0; t < 15 && kTriangleTable[i][t] >= 0; t += 3)
+                        for (int k = 0; k < 3; ++k)
                         {
-                            GridVertex& gv = grid[x + (sizeX - 1) * (y + (sizeY - 1) * z)];
+                            int e0 = kTriangleTable[i][t + k];
+                            int e1 = kTriangleTable[i][t + (k + 1) % 3];
+                            int face = getEdgeFace(e0, e1);
                             
-                            if (estimateNormals)
+                            if (face >= 0)
                             {
-                                const Cell& c000 = box(x + 0, y + 0, z + 0);
-                                const Cell& c100 = box(x + 1, y + 0, z + 0);
-                                const Cell& c110 = box(x + 1, y + 1, z + 0);
-                                const Cell& c010 = box(x + 0, y + 1, z + 0);
-                                const Cell& c001 = box(x + 0, y + 0, z + 1);
-                                const Cell& c101 = box(x + 1, y + 0, z + 1);
-                                const Cell& c111 = box(x + 1, y + 1, z + 1);
-                                const Cell& c011 = box(x + 0, y + 1, z + 1);
+                                FaceSegments& fs = cases[i][face];
+                                assert(fs.count < 2);
                                 
-                                gv.iso = (
-                                          (c000.occupancy + c100.occupancy + c110.occupancy + c010.occupancy) +
-                                          (c001.occupancy + c101.occupancy + c111.occupancy + c011.occupancy)) / float(255 * 8);
-                                
-                                gv.nx = -(
-                                          (c100.occupancy + c110.occupancy + c101.occupancy + c111.occupancy) -
-                                          (c000.occupancy + c010.occupancy + c001.occupancy + c011.occupancy)) / float(255 * 4);
-                                
-                                gv.ny = -(
-                                          (c110.occupancy + c010.occupancy + c111.occupancy + c011.occupancy) -
-                                          (c100.occupancy + c000.occupancy + c101.occupancy + c001.occupancy)) / float(255 * 4);
-                                
-                                gv.nz = -(
-                                          (c001.occupancy + c101.occupancy + c111.occupancy + c011.occupancy) -
-                                          (c000.occupancy + c100.occupancy + c110.occupancy + c010.occupancy)) / float(255 * 4);
-                            }
-                            else
-                            {
-                                gv.iso = box(x, y, z).occupancy;
-                                gv.nx = 0;
-                                gv.ny = 0;
-                                gv.nz = 1;
+                                fs.edges[fs.count][0] = e0;
+                                fs.edges[fs.count][1] = e1;
+                                fs.count++;
                             }
                         }
+            }
+        };
+        
+        static const FaceSegmentTable kFaceSegmentTable;
+        
+        // transition vertices are kept apart until the regular vertices are shrunk away from transition faces
+        static const unsigned int kTransitionVertex = 1u << 31;
+        
+        // depth of transition cells in cells; regular cells next to transition faces shrink to the rest of the cell
+        static const float kTransitionWidth = 0.5f;
+        
+        // Cells between a face of the meshed box and a neighbour at twice the resolution (as in Transvoxel, without the
+        // case tables): each transition cell has the 3x3 fine samples of its face on the outside and the 2x2 samples of the
+        // shrunk regular cell on the inside. Contours on the fine and coarse faces are taken from the neighbouring cubes, so
+        // they match the fine mesh and the regular cells; side faces use a fixed rule shared by adjacent transition cells.
+        // The resulting boundary loops are triangulated.
+        template <typename Volume> class TransitionGenerator
+        {
+        public:
+            TransitionGenerator(const Volume& box, const Box& fineBox, unsigned int faces, const glm::i32vec3& size, const vec3& offset, float cellSize, float isolevel, EdgeCache& cache)
+            : box(box)
+            , fineBox(fineBox)
+            , faces(faces)
+            , size(size)
+            , offset(offset)
+            , cellSize(cellSize)
+            , isolevel(isolevel)
+            , cache(cache)
+            {
+                assert(fineBox.getWidth() == size.x * 2 + 3 && fineBox.getHeight() == size.y * 2 + 3 && fineBox.getDepth() == size.z * 2 + 3);
+            }
+            
+            // Emits transition cells next to the cube layer z; the edge cache must hold the slab of that layer
+            void generate(int z)
+            {
+                for (int face = 0; face < 6; ++face)
+                {
+                    if ((faces & (1 << face)) == 0)
+                        continue;
+                    
+                    int axis = face >> 1;
+                    int layer = (face & 1) ? size[axis] - 1 : 0;
+                    
+                    if (axis == 2)
+                    {
+                        if (z == layer)
+                            for (int y = 0; y < size.y; ++y)
+                                for (int x = 0; x < size.x; ++x)
+                                    generateCell(face, glm::i32vec3(x, y, z));
+                    }
+                    else
+                    {
+                        int other = 1 - axis;
+                        
+                        for (int i = 0; i < size[other]; ++i)
+                        {
+                            glm::i32vec3 cube(0, 0, z);
+                            cube[axis] = layer;
+                            cube[other] = i;
+                            
+                            generateCell(face, cube);
+                        }
+                    }
+                }
+            }
+            
+            // Shrinks regular cells away from transition faces and triangulates transition cells; vb holds regular vertices
+            void finish(vector<MeshVertex>& vb, vector<unsigned int>& ib)
+            {
+                for (auto& v: vb)
+                    v.position = offset + shrink((v.position - offset) / cellSize) * cellSize;
                 
-                vector<MeshVertex> vb;
-                vector<unsigned int> ib;
+                unsigned int base = vb.size();
+                
+                vb.insert(vb.end(), vertices.begin(), vertices.end());
+                
+                for (auto& i: loops)
+                    if (i & kTransitionVertex)
+                        i = base + (i & ~kTransitionVertex);
+                
+                for (size_t i = 0, start = 0; i < loopSizes.size(); start += loopSizes[i], ++i)
+                {
+                    const unsigned int* loop = &loops[start];
+                    unsigned int count = loopSizes[i];
+                    
+                    if (count == 3)
+                    {
+                        ib.insert(ib.end(), loop, loop + 3);
+                        continue;
+                    }
+                    
+                    vec3 center;
+                    
+                    for (unsigned int k = 0; k < count; ++k)
+                        center += vb[loop[k]].position;
+                    
+                    unsigned int ci = vb.size();
+                    
+                    vb.push_back({ center / float(count), vec3() });
+                    
+                    for (unsigned int k = 0; k < count; ++k)
+                    {
+                        ib.push_back(loop[k]);
+                        ib.push_back(loop[(k + 1) % count]);
+                        ib.push_back(ci);
+                    }
+                }
+            }
+            
+        private:
+            struct Point
+            {
+                bool fine;
+                glm::i32vec3 position;
+            };
+            
+            // fine samples lie in the transition face, coarse samples are the corners of the regular cube
+            bool isInside(const Point& p) const
+            {
+                return (p.fine ? getFine(p.position) : getCoarse(p.position)) >= isolevel;
+            }
+            
+            float getFine(const glm::i32vec3& p) const
+            {
+                return fineBox.getOccupancy(p.x + 1, p.y + 1, p.z + 1);
+            }
+            
+            float getCoarse(const glm::i32vec3& p) const
+            {
+                return box.getOccupancy(p.x, p.y, p.z);
+            }
+            
+            float getIntersection(float g0, float g1) const
+            {
+                return (fabsf(g0 - g1) > 0.0001) ? (isolevel - g0) / (g1 - g0) : 0;
+            }
+            
+            // maps regular positions (in cells) within one cell of a transition face to the inner part of that cell
+            vec3 shrink(vec3 p) const
+            {
+                for (int face = 0; face < 6; ++face)
+                {
+                    if ((faces & (1 << face)) == 0)
+                        continue;
+                    
+                    int axis = face >> 1;
+                    float depth = (face & 1) ? size[axis] - p[axis] : p[axis];
+                    
+                    if (depth < 1)
+                    {
+                        float shrunk = kTransitionWidth + depth * (1 - kTransitionWidth);
+                        
+                        p[axis] = (face & 1) ? size[axis] - shrunk : shrunk;
+                    }
+                }
+                
+                return p;
+            }
+            
+            unsigned int addVertex(const vec3& position)
+            {
+                vertices.push_back({ offset + position * cellSize, vec3() });
+                
+                return kTransitionVertex | (vertices.size() - 1);
+            }
+            
+            unsigned int getFineEdgeVertex(glm::i32vec3 p0, glm::i32vec3 p1)
+            {
+                if (p1.x + p1.y + p1.z < p0.x + p0.y + p0.z)
+                    std::swap(p0, p1);
+                
+                unsigned long long key = (((unsigned long long)(p0.z + 1) << 42 | (unsigned long long)(p0.y + 1) << 21 | (p0.x + 1)) << 2) | (p1.x != p0.x ? 0 : p1.y != p0.y ? 1 : 2);
                 
-                for (int z = 0; z < sizeZ - 2; ++z)
-                    for (int y = 0; y < sizeY - 2; ++y)
-                        for (int x = 0; x < sizeX - 2; ++x)
+                auto it = fineEdges.find(key);
+                
+                if (it != fineEdges.end())
+                    return it->second;
+                
+                float t = getIntersection(getFine(p0), getFine(p1));
+                
+                return fineEdges[key] = addVertex(glm::mix(vec3(p0), vec3(p1), t) / 2.f);
+            }
+            
+            // edge from the fine sample at a coarse corner to the same corner of the shrunk regular cube
+            unsigned int getCornerVertex(const glm::i32vec3& p)
+            {
+                auto it = cornerEdges.find(p);
+                
+                if (it != cornerEdges.end())
+                    return it->second;
+                
+                float t = getIntersection(getFine(p * 2), getCoarse(p));
+                
+                return cornerEdges[p] = addVertex(glm::mix(vec3(p), shrink(vec3(p)), t));
+            }
+            
+            unsigned int getEdgeVertex(const glm::i32vec3& cube, const Point& p0, const Point& p1)
+            {
+                if (p0.fine && p1.fine)
+                    return getFineEdgeVertex(p0.position, p1.position);
+                
+                if (!p0.fine && !p1.fine)
+                    return cache.get(cube, getCornerEdge(getCorner(p0.position - cube), getCorner(p1.position - cube)));
+                
+                return getCornerVertex(p0.fine ? p1.position : p0.position);
+            }
+            
+            static glm::i32vec3 getCornerOffset(unsigned char corner)
+            {
+                return glm::i32vec3(kVertexIndexTable[corner][0], kVertexIndexTable[corner][1], kVertexIndexTable[corner][2]);
+            }
+            
+            template <typename F> static int getCubeIndex(const glm::i32vec3& cube, float isolevel, F get)
+            {
+                int cubeindex = 0;
+                
+                for (int i = 0; i < 8; ++i)
+                    if (get(cube + getCornerOffset(i)) < isolevel)
+                        cubeindex |= 1 << i;
+                
+                return cubeindex;
+            }
+            
+            // side faces have three fine samples along the transition face and two coarse samples inside; the contour cuts
+            // off every run of inside samples, oriented like the cube faces
+            void addSideSegments(vector<pair<unsigned int, unsigned int>>& segments, const glm::i32vec3& cube, const glm::i32vec3& base, const glm::i32vec3& normal, const glm::i32vec3& along, const glm::i32vec3& inward)
+            {
+                Point points[5] =
+                {
+                    { true, base * 2 },
+                    { true, base * 2 + along },
+                    { true, base * 2 + along * 2 },
+                    { false, base + along },
+                    { false, base }
+                };
+                
+                // walk the polygon counterclockwise as seen from outside the cell
+                if (glm::dot(glm::cross(vec3(along), vec3(inward)), vec3(normal)) < 0)
+                    std::reverse(points, points + 5);
+                
+                bool inside[5];
+                
+                for (int k = 0; k < 5; ++k)
+                    inside[k] = isInside(points[k]);
+                
+                for (int k = 0; k < 5; ++k)
+                {
+                    if (inside[k] || !inside[(k + 1) % 5])
+                        continue;
+                    
+                    int m = (k + 1) % 5;
+                    
+                    while (!(inside[m] && !inside[(m + 1) % 5]))
+                        m = (m + 1) % 5;
+                    
+                    segments.push_back(make_pair(getEdgeVertex(cube, points[k], points[(k + 1) % 5]), getEdgeVertex(cube, points[m], points[(m + 1) % 5])));
+                }
+            }
+            
+            void generateCell(int face, const glm::i32vec3& cube)
+            {
+                int axis = face >> 1;
+                int side = face & 1;
+                
+                glm::i32vec3 du(0), dv(0), outward(0);
+                du[(axis + 1) % 3] = 1;
+                dv[(axis + 2) % 3] = 1;
+                outward[axis] = side ? 1 : -1;
+                
+                // coarse corner of the cell in the transition face
+                glm::i32vec3 base = cube;
+                base[axis] += side;
+                
+                bool any = false, all = true;
+                
+                for (int j = 0; j < 3; ++j)
+                    for (int i = 0; i < 3; ++i)
+                    {
+                        bool in = getFine(base * 2 + du * i + dv * j) >= isolevel;
+                        
+                        any |= in;
+                        all &= in;
+                    }
+                
+                for (int j = 0; j < 2; ++j)
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        bool in = getCoarse(base + du * i + dv * j) >= isolevel;
+                        
+                        any |= in;
+                        all &= in;
+                    }
+                
+                if (!any || all)
+                    return;
+                
+                vector<pair<unsigned int, unsigned int>>& segments = scratchSegments;
+                segments.clear();
+                
+                // fine face: boundary of the fine neighbour cubes, reversed
+                for (int j = 0; j < 2; ++j)
+                    for (int i = 0; i < 2; ++i)
+                    {
+                        glm::i32vec3 fineCube = base * 2 + du * i + dv * j;
+                        
+                        if (!side)
+                            fineCube[axis] -= 1;
+                        
+                        const FaceSegments& fs = kFaceSegmentTable.cases[getCubeIndex(fineCube, isolevel, [&](const glm::i32vec3& p) { return getFine(p); })][face ^ 1];
+                        
+                        auto getFineVertex = [&](unsigned char edge) {
+                            const unsigned char* e = kEdgeIndexTable[edge];
+                            
+                            return getFineEdgeVertex(fineCube + getCornerOffset(e[0]), fineCube + getCornerOffset(e[1]));
+                        };
+                        
+                        for (int k = 0; k < fs.count; ++k)
+                            segments.push_back(make_pair(getFineVertex(fs.edges[k][1]), getFineVertex(fs.edges[k][0])));
+                    }
+                
+                // coarse face: boundary of the regular cube, reversed
+                const FaceSegments& fs = kFaceSegmentTable.cases[getCubeIndex(cube, isolevel, [&](const glm::i32vec3& p) { return getCoarse(p); })][face];
+                
+                for (int k = 0; k < fs.count; ++k)
+                    segments.push_back(make_pair(cache.get(cube, fs.edges[k][1]), cache.get(cube, fs.edges[k][0])));
+                
+                addSideSegments(segments, cube, base, -du, dv, -outward);
+                addSideSegments(segments, cube, base + du, du, dv, -outward);
+                addSideSegments(segments, cube, base, -dv, du, -outward);
+                addSideSegments(segments, cube, base + dv, dv, du, -outward);
+                
+                // coarse crossings come from the regular cells, so a missing one means the contours disagree;
+                // release builds skip the cell and leave a hole instead of emitting a broken loop
+                for (auto& s: segments)
+                    if (s.first == kEmptyEdge || s.second == kEmptyEdge)
+                    {
+                        assert(!"Transition cell segment has no regular edge vertex");
+                        return;
+                    }
+                
+                // chain segments into loops; every crossing ends one segment and starts another
+                size_t loopsStart = loops.size();
+                size_t loopSizesStart = loopSizes.size();
+                
+                while (!segments.empty())
+                {
+                    unsigned int first = segments.back().first;
+                    unsigned int next = segments.back().second;
+                    segments.pop_back();
+                    
+                    loops.push_back(first);
+                    unsigned int count = 1;
+                    
+                    while (next != first)
+                    {
+                        auto it = find_if(segments.begin(), segments.end(), [&](const pair<unsigned int, unsigned int>& s) { return s.first == next; });
+                        
+                        if (it == segments.end())
                         {
-                            const GridVertex& v000 = grid[(x + 0) + (sizeX - 1) * ((y + 0) + (sizeY - 1) * (z + 0))];
-                            const GridVertex& v100 = grid[(x + 1) + (sizeX - 1) * ((y + 0) + (sizeY - 1) * (z + 0))];
-                            const GridVertex& v110 = grid[(x + 1) + (sizeX - 1) * ((y + 1) + (sizeY - 1) * (z + 0))];
-                            const GridVertex& v010 = grid[(x + 0) + (sizeX - 1) * ((y + 1) + (sizeY - 1) * (z + 0))];
-                            const GridVertex& v001 = grid[(x + 0) + (sizeX - 1) * ((y + 0) + (sizeY - 1) * (z + 1))];
-                            const GridVertex& v101 = grid[(x + 1) + (sizeX - 1) * ((y + 0) + (sizeY - 1) * (z + 1))];
-                            const GridVertex& v111 = grid[(x + 1) + (sizeX - 1) * ((y + 1) + (sizeY - 1) * (z + 1))];
-                            const GridVertex& v011 = grid[(x + 0) + (sizeX - 1) * ((y + 1) + (sizeY - 1) * (z + 1))];
+                            assert(!"Transition cell contour does not close");
                             
-                            CubeGenerator<lod>::generate(vb, ib, v000, v100, v110, v010, v001, v101, v111, v011, isolevel, offset + vec3(x, y, z) * cellSize, cellSize);
+                            loops.resize(loopsStart);
+                            loopSizes.resize(loopSizesStart);
+                            return;
                         }
+                        
+                        loops.push_back(next);
+                        count++;
+                        
+                        next = it->second;
+                        segments.erase(it);
+                    }
+                    
+                    loopSizes.push_back(count);
+                }
+            }
+            
+            const Volume& box;
+            const Box& fineBox;
+            unsigned int faces;
+            glm::i32vec3 size;
+            vec3 offset;
+            float cellSize;
+            float isolevel;
+            EdgeCache& cache;
+            
+            vector<MeshVertex> vertices;
+            vector<unsigned int> loops;
+            vector<unsigned int> loopSizes;
+            
+            unordered_map<unsigned long long, unsigned int> fineEdges;
+            unordered_map<glm::i32vec3, unsigned int> cornerEdges;
+            
+            vector<pair<unsigned int, unsigned int>> scratchSegments;
+        };
+        
+        class Mesher: public voxel::Mesher
+        {
+            MeshBorder getBorder() const override
+            {
+                // cubes are emitted for [0, size) and read their far corners at size
+                return { 0, 1 };
+            }
+            
+            pair<vector<MeshVertex>, vector<unsigned int>> generate(const Box& box, const vec3& offset, float cellSize, const MeshOptions& options) override
+            {
+                return generateImpl(box, offset, cellSize, options);
+            }
+            
+            pair<vector<MeshVertex>, vector<unsigned int>> generate(const GridView& view, const vec3& offset, float cellSize, const MeshOptions& options) override
+            {
+                return generateImpl(view, offset, cellSize, options);
+            }
+            
+            template <typename Volume> pair<vector<MeshVertex>, vector<unsigned int>> generateImpl(const Volume& box, const vec3& offset, float cellSize, const MeshOptions& options)
+            {
+                const int lod = 0;
+                const float isolevel = kIsolevel;
                 
-                if (!estimateNormals)
+                unsigned int sizeX = box.getWidth(), sizeY = box.getHeight(), sizeZ = box.getDepth();
+                assert(sizeX > 1 && sizeY > 1 && sizeZ > 1);
+                
+                unsigned int slice = sizeX * sizeY;
+                
+                // grid values are raw occupancy, so only empty cells are below isolevel; signs are kept for slices z and z + 1
+                unique_ptr<unsigned char[]> signs(new unsigned char[slice * 2]);
+                
+                unique_ptr<unsigned char[]> cubes(new unsigned char[sizeX - 1]);
+                
+                // edges of one slab of cubes at the finest subdivision level
+                EdgeCache cache(((sizeX - 1) << lod) + 1, ((sizeY - 1) << lod) + 1, (1 << lod) + 1);
+                
+                vector<MeshVertex> vb;
+                vector<unsigned int> ib;
+                
+                unique_ptr<TransitionGenerator<Volume>> transitions;
+                
+                if (options.transitionFaces && options.transitionBox)
+                    transitions = make_unique<TransitionGenerator<Volume>>(box, *options.transitionBox, options.transitionFaces, glm::i32vec3(sizeX - 1, sizeY - 1, sizeZ - 1), offset, cellSize, isolevel, cache);
+                
+                classifySlice(signs.get(), box, 0, 1);
+                
+                for (int z = 0; z < sizeZ - 1; ++z)
                 {
-                    // rebuild normals from scratch
-                    unordered_map<glm::i32vec3, vec3> normals;
+                    const unsigned char* signs0 = &signs[slice * (z & 1)];
+                    unsigned char* signs1 = &signs[slice * ((z + 1) & 1)];
                     
-                    #define Q(v) glm::i32vec3((v - offset) * 16.f + 0.5f)
+                    classifySlice(signs1, box, z + 1, 1);
                     
-                    for (size_t i = 0; i < ib.size(); i += 3)
+                    for (int y = 0; y < sizeY - 1; ++y)
                     {
-                        vec3 vn = glm::cross(vb[ib[i+1]].position - vb[ib[i+0]].position, vb[ib[i+2]].position - vb[ib[i+0]].position);
-                        normals[Q(vb[ib[i+0]].position)] += vn;
-                        normals[Q(vb[ib[i+1]].position)] += vn;
-                        normals[Q(vb[ib[i+2]].position)] += vn;
+                        const unsigned char* s00 = &signs0[sizeX * (y + 0)];
+                        const unsigned char* s10 = &signs0[sizeX * (y + 1)];
+                        const unsigned char* s01 = &signs1[sizeX * (y + 0)];
+                        const unsigned char* s11 = &signs1[sizeX * (y + 1)];
+                        
+                        // skip rows that are entirely inside or outside
+                        if (computeCubeIndices(cubes.get(), s00, s10, s01, s11, sizeX - 1) == 0)
+                            continue;
+                        
+                        for (int x = 0; x < sizeX - 1; ++x)
+                        {
+                            if (cubes[x] == 0 || cubes[x] == 255)
+                                continue;
+                            
+                            #define V(dx, dy, dz) GridVertex { float(box.getOccupancy(x + dx, y + dy, z + dz)), 0, 0, 1 }
+                            
+                            CubeGenerator<lod>::generate(vb, ib, cache, glm::i32vec3(x, y, z) * (1 << lod),
+                                V(0, 0, 0), V(1, 0, 0), V(1, 1, 0), V(0, 1, 0), V(0, 0, 1), V(1, 0, 1), V(1, 1, 1), V(0, 1, 1),
+                                isolevel, offset + vec3(x, y, z) * cellSize, cellSize);
+                            
+                            #undef V
+                        }
                     }
                     
-                    for (size_t i = 0; i < vb.size(); ++i)
-                        vb[i].normal = glm::normalize(normals[Q(vb[i].position)]);
+                    if (transitions)
+                        transitions->generate(z);
                     
-                    #undef Q
+                    cache.advance();
                 }
                 
+                if (transitions)
+                    transitions->finish(vb, ib);
+                
+                // rebuild normals from scratch by accumulating face normals of shared vertices
+                vector<vec3> normals(vb.size());
+                
+                for (size_t i = 0; i < ib.size(); i += 3)
+                {
+                    vec3 vn = glm::cross(vb[ib[i+1]].position - vb[ib[i+0]].position, vb[ib[i+2]].position - vb[ib[i+0]].position);
+                    normals[ib[i+0]] += vn;
+                    normals[ib[i+1]] += vn;
+                    normals[ib[i+2]] += vn;
+                }
+                
+                for (size_t i = 0; i < vb.size(); ++i)
+                    vb[i].normal = glm::normalize(normals[i]);
+                
                 return make_pair(move(vb), move(ib));
             }
         };
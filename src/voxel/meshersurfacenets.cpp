@@ -2,6 +2,8 @@
 #include "voxel/mesher.hpp"
 
 #include "voxel/grid.hpp"
+#include "voxel/gridview.hpp"
+#include "voxel/cubeindex.hpp"
 
 namespace voxel
 {
@@ -150,37 +152,28 @@ namespace voxel
             }
         }
         
-        void pushQuad(vector<MeshVertex>& vb, vector<unsigned int>& ib,
-            const pair<vec3, MeshVertex>& v0, const pair<vec3, MeshVertex>& v1, const pair<vec3, MeshVertex>& v2, const pair<vec3, MeshVertex>& v3,
-            bool flip)
+        // Quad vertices are stored in triangle winding order
+        struct Quad
+        {
+            unsigned int v[4];
+        };
+        
+        void pushQuad(vector<Quad>& quads, unsigned int i0, unsigned int i1, unsigned int i2, unsigned int i3, bool flip)
         {
-            size_t offset = vb.size();
-            
-            vec3 qn = (flip ? -1.f : 1.f) * getQuadNormal(v0.second.position, v1.second.position, v2.second.position, v3.second.position);
-            
-            vb.push_back(normalLerp(v0.second, v0.first, qn));
-            vb.push_back(normalLerp(v1.second, v1.first, qn));
-            vb.push_back(normalLerp(v2.second, v2.first, qn));
-            vb.push_back(normalLerp(v3.second, v3.first, qn));
-            
             if (!flip)
-            {
-                ib.push_back(offset + 0);
-                ib.push_back(offset + 2);
-                ib.push_back(offset + 1);
-                ib.push_back(offset + 0);
-                ib.push_back(offset + 3);
-                ib.push_back(offset + 2);
-            }
+                quads.push_back(Quad {{ i0, i3, i2, i1 }});
             else
-            {
-                ib.push_back(offset + 0);
-                ib.push_back(offset + 1);
-                ib.push_back(offset + 2);
-                ib.push_back(offset + 0);
-                ib.push_back(offset + 2);
-                ib.push_back(offset + 3);
-            }
+                quads.push_back(Quad {{ i0, i1, i2, i3 }});
+        }
+        
+        void pushQuadIndices(vector<unsigned int>& ib, unsigned int i0, unsigned int i1, unsigned int i2, unsigned int i3)
+        {
+            ib.push_back(i0);
+            ib.push_back(i1);
+            ib.push_back(i2);
+            ib.push_back(i0);
+            ib.push_back(i2);
+            ib.push_back(i3);
         }
         
         struct AdjustableLerpKSmooth
@@ -224,55 +217,71 @@ namespace voxel
 
         class Mesher: public voxel::Mesher
         {
+            MeshBorder getBorder() const override
+            {
+                // cell vertices are placed in cubes [-1, size), quads are emitted for edges in [0, size)
+                return { 1, 1 };
+            }
+            
             pair<vector<MeshVertex>, vector<unsigned int>> generate(const Box& box, const vec3& offset, float cellSize, const MeshOptions& options) override
+            {
+                return generateImpl(box, offset, cellSize, options);
+            }
+            
+            pair<vector<MeshVertex>, vector<unsigned int>> generate(const GridView& view, const vec3& offset, float cellSize, const MeshOptions& options) override
+            {
+                return generateImpl(view, offset, cellSize, options);
+            }
+            
+            template <typename Volume> pair<vector<MeshVertex>, vector<unsigned int>> generateImpl(const Volume& box, const vec3& offset, float cellSize, const MeshOptions& options)
             {
                 typedef AdjustableNaiveTraits<AdjustableLerpKSmooth> Traits;
                 
-                const float isolevel = 0.5f / 255.f;
+                // grid values are normalized to 0..1
+                const float isolevel = kIsolevel / 255.f;
                 
                 unsigned int sizeX = box.getWidth(), sizeY = box.getHeight(), sizeZ = box.getDepth();
                 assert(sizeX > 2 && sizeY > 2 && sizeZ > 2);
                 
-                unique_ptr<GridVertex[]> grid(new GridVertex[sizeX * sizeY * sizeZ]);
+                unsigned int slice = sizeX * sizeY;
                 
-                for (int z = 0; z < sizeZ; ++z)
-                    for (int y = 0; y < sizeY; ++y)
-                        for (int x = 0; x < sizeX; ++x)
-                        {
-                            GridVertex& gv = grid[x + sizeX * (y + sizeY * z)];
-                            
-                            gv.iso = box(x, y, z).occupancy / 255.f;
-                            gv.nx = 0;
-                            gv.ny = 0;
-                            gv.nz = 1;
-                        }
+                // cells with occupancy / 255 < isolevel are outside; signs are kept for slices z and z + 1
+                unique_ptr<unsigned char[]> signs(new unsigned char[slice * 2]);
+                
+                // each surface cell has one vertex; quads reference it by index, and only reach back one cell layer
+                unique_ptr<unsigned int[]> vertices(new unsigned int[slice * 2]);
+                unique_ptr<unsigned char[]> cubes(new unsigned char[sizeX - 1]);
+                
+                vector<MeshVertex> vb;
+                vector<vec3> centers;
+                vector<Quad> quads;
                 
-                unique_ptr<pair<vec3, MeshVertex>[]> gv(new pair<vec3, MeshVertex>[sizeX * sizeY * sizeZ]);
+                classifySlice(signs.get(), box, 0, 1);
                 
                 for (int z = 0; z + 1 < sizeZ; ++z)
+                {
+                    const unsigned char* signs0 = &signs[slice * (z & 1)];
+                    unsigned char* signs1 = &signs[slice * ((z + 1) & 1)];
+                    
+                    unsigned int* vertices0 = &vertices[slice * (z & 1)];
+                    const unsigned int* verticesPrev = &vertices[slice * ((z + 1) & 1)];
+                    
+                    classifySlice(signs1, box, z + 1, 1);
+                    
                     for (int y = 0; y + 1 < sizeY; ++y)
+                    {
+                        const unsigned char* s00 = &signs0[sizeX * (y + 0)];
+                        const unsigned char* s10 = &signs0[sizeX * (y + 1)];
+                        const unsigned char* s01 = &signs1[sizeX * (y + 0)];
+                        const unsigned char* s11 = &signs1[sizeX * (y + 1)];
+                        
+                        // skip rows that are entirely inside or outside
+                        if (computeCubeIndices(cubes.get(), s00, s10, s01, s11, sizeX - 1) == 0)
+                            continue;
+                        
                         for (int x = 0; x + 1 < sizeX; ++x)
                         {
-                            const GridVertex& v000 = grid[(x + 0) + sizeX * ((y + 0) + sizeY * (z + 0))];
-                            const GridVertex& v100 = grid[(x + 1) + sizeX * ((y + 0) + sizeY * (z + 0))];
-                            const GridVertex& v110 = grid[(x + 1) + sizeX * ((y + 1) + sizeY * (z + 0))];
-                            const GridVertex& v010 = grid[(x + 0) + sizeX * ((y + 1) + sizeY * (z + 0))];
-                            const GridVertex& v001 = grid[(x + 0) + sizeX * ((y + 0) + sizeY * (z + 1))];
-                            const GridVertex& v101 = grid[(x + 1) + sizeX * ((y + 0) + sizeY * (z + 1))];
-                            const GridVertex& v111 = grid[(x + 1) + sizeX * ((y + 1) + sizeY * (z + 1))];
-                            const GridVertex& v011 = grid[(x + 0) + sizeX * ((y + 1) + sizeY * (z + 1))];
-                            
-                            // get cube index from grid values
-                            int cubeindex = 0;
-                            
-                            if (v000.iso < isolevel) cubeindex |= 1 << 0;
-                            if (v100.iso < isolevel) cubeindex |= 1 << 1;
-                            if (v110.iso < isolevel) cubeindex |= 1 << 2;
-                            if (v010.iso < isolevel) cubeindex |= 1 << 3;
-                            if (v001.iso < isolevel) cubeindex |= 1 << 4;
-                            if (v101.iso < isolevel) cubeindex |= 1 << 5;
-                            if (v111.iso < isolevel) cubeindex |= 1 << 6;
-                            if (v011.iso < isolevel) cubeindex |= 1 << 7;
+                            int cubeindex = cubes[x];
                             
                             int edgemask = kEdgeTable[cubeindex];
                             
@@ -298,8 +307,8 @@ namespace voxel
                                         int p1y = kVertexIndexTable[e1][1];
                                         int p1z = kVertexIndexTable[e1][2];
                                         
-                                        const GridVertex& g0 = grid[(x + p0x) + sizeX * ((y + p0y) + sizeY * (z + p0z))];
-                                        const GridVertex& g1 = grid[(x + p1x) + sizeX * ((y + p1y) + sizeY * (z + p1z))];
+                                        GridVertex g0 = { box.getOccupancy(x + p0x, y + p0y, z + p0z) / 255.f, 0, 0, 1 };
+                                        GridVertex g1 = { box.getOccupancy(x + p1x, y + p1y, z + p1z) / 255.f, 0, 0, 1 };
                                         
                                         pair<vec3, vec3> gt = Traits::intersect(g0, g1, isolevel, corner, vec3(p0x, p0y, p0z) * cellSize, vec3(p1x, p1y, p1z) * cellSize);
                                         
@@ -310,75 +319,127 @@ namespace voxel
                                 
                                 pair<vec3, vec3> ga = Traits::average(ev, ecount, vec3(), vec3(cellSize), corner);
                                 
-                                gv[x + sizeX * (y + sizeY * z)] = make_pair(corner + evavg / float(ecount), MeshVertex { corner + ga.first, glm::normalize(ga.second) });
+                                vertices0[x + sizeX * y] = vb.size();
+                                vb.push_back(MeshVertex { corner + ga.first, glm::normalize(ga.second) });
+                                centers.push_back(corner + evavg / float(ecount));
                             }
                         }
-                
-                vector<MeshVertex> vb;
-                vector<unsigned int> ib;
-                
-                for (int z = 1; z + 1 < sizeZ; ++z)
+                    }
+                    
+                    if (z == 0)
+                        continue;
+                    
+                    // quads connect cell vertices of this layer and the previous one
                     for (int y = 1; y + 1 < sizeY; ++y)
                         for (int x = 1; x + 1 < sizeX; ++x)
                         {
-                            const GridVertex& v000 = grid[(x + 0) + sizeX * ((y + 0) + sizeY * (z + 0))];
-                            const GridVertex& v100 = grid[(x + 1) + sizeX * ((y + 0) + sizeY * (z + 0))];
-                            const GridVertex& v010 = grid[(x + 0) + sizeX * ((y + 1) + sizeY * (z + 0))];
-                            const GridVertex& v001 = grid[(x + 0) + sizeX * ((y + 0) + sizeY * (z + 1))];
+                            bool s000 = signs0[(x + 0) + sizeX * (y + 0)];
+                            bool s100 = signs0[(x + 1) + sizeX * (y + 0)];
+                            bool s010 = signs0[(x + 0) + sizeX * (y + 1)];
+                            bool s001 = signs1[(x + 0) + sizeX * (y + 0)];
                             
                             // add quads
-                            if ((v000.iso < isolevel) != (v100.iso < isolevel))
+                            if (s000 != s100)
                             {
-                                pushQuad(vb, ib,
-                                         gv[(x + 0) + sizeX * ((y + 0) + sizeY * (z + 0))],
-                                         gv[(x + 0) + sizeX * ((y - 1) + sizeY * (z + 0))],
-                                         gv[(x + 0) + sizeX * ((y - 1) + sizeY * (z - 1))],
-                                         gv[(x + 0) + sizeX * ((y + 0) + sizeY * (z - 1))],
-                                         !(v000.iso < isolevel));
+                                pushQuad(quads,
+                                         vertices0[(x + 0) + sizeX * (y + 0)],
+                                         vertices0[(x + 0) + sizeX * (y - 1)],
+                                         verticesPrev[(x + 0) + sizeX * (y - 1)],
+                                         verticesPrev[(x + 0) + sizeX * (y + 0)],
+                                         !s000);
                             }
                             
-                            if ((v000.iso < isolevel) != (v010.iso < isolevel))
+                            if (s000 != s010)
                             {
-                                pushQuad(vb, ib,
-                                         gv[(x + 0) + sizeX * ((y + 0) + sizeY * (z + 0))],
-                                         gv[(x - 1) + sizeX * ((y + 0) + sizeY * (z + 0))],
-                                         gv[(x - 1) + sizeX * ((y + 0) + sizeY * (z - 1))],
-                                         gv[(x + 0) + sizeX * ((y + 0) + sizeY * (z - 1))],
-                                         v000.iso < isolevel);
+                                pushQuad(quads,
+                                         vertices0[(x + 0) + sizeX * (y + 0)],
+                                         vertices0[(x - 1) + sizeX * (y + 0)],
+                                         verticesPrev[(x - 1) + sizeX * (y + 0)],
+                                         verticesPrev[(x + 0) + sizeX * (y + 0)],
+                                         s000);
                             }
                             
-                            if ((v000.iso < isolevel) != (v001.iso < isolevel))
+                            if (s000 != s001)
                             {
-                                pushQuad(vb, ib,
-                                         gv[(x + 0) + sizeX * ((y + 0) + sizeY * (z + 0))],
-                                         gv[(x - 1) + sizeX * ((y + 0) + sizeY * (z + 0))],
-                                         gv[(x - 1) + sizeX * ((y - 1) + sizeY * (z + 0))],
-                                         gv[(x + 0) + sizeX * ((y - 1) + sizeY * (z + 0))],
-                                         !(v000.iso < isolevel));
+                                pushQuad(quads,
+                                         vertices0[(x + 0) + sizeX * (y + 0)],
+                                         vertices0[(x - 1) + sizeX * (y + 0)],
+                                         vertices0[(x - 1) + sizeX * (y - 1)],
+                                         vertices0[(x + 0) + sizeX * (y - 1)],
+                                         !s000);
                             }
                         }
+                }
                 
-                if (true)
+                // drop vertices of border cells that no quad references
+                vector<unsigned int> remap(vb.size(), 0);
+                size_t count = 0;
+                
+                for (auto& q: quads)
+                    for (int i = 0; i < 4; ++i)
+                        remap[q.v[i]] = 1;
+                
+                for (size_t i = 0; i < vb.size(); ++i)
+                    if (remap[i])
+                    {
+                        remap[i] = count;
+                        vb[count] = vb[i];
+                        centers[count] = centers[i];
+                        count++;
+                    }
+                
+                vb.resize(count);
+                centers.resize(count);
+                
+                for (auto& q: quads)
+                    for (int i = 0; i < 4; ++i)
+                        q.v[i] = remap[q.v[i]];
+                
+                vector<unsigned int> ib;
+                
+                ib.reserve(quads.size() * 6);
+                
+                for (auto& q: quads)
+                    pushQuadIndices(ib, q.v[0], q.v[1], q.v[2], q.v[3]);
+                
+                // rebuild normals from scratch by accumulating face normals of shared vertices
+                vector<vec3> normals(vb.size());
+                
+                for (size_t i = 0; i < ib.size(); i += 3)
                 {
-                    // rebuild normals from scratch
-                    unordered_map<glm::i32vec3, vec3> normals;
+                    vec3 vn = glm::cross(vb[ib[i+1]].position - vb[ib[i+0]].position, vb[ib[i+2]].position - vb[ib[i+0]].position);
+                    normals[ib[i+0]] += vn;
+                    normals[ib[i+1]] += vn;
+                    normals[ib[i+2]] += vn;
+                }
+                
+                for (size_t i = 0; i < vb.size(); ++i)
+                    vb[i].normal = glm::normalize(normals[i]);
+                
+                if (options.blendQuadNormals)
+                {
+                    // unshare vertices so that each quad can bend normals towards its face normal
+                    vector<MeshVertex> qvb;
+                    vector<unsigned int> qib;
                     
-                    #define Q(v) glm::i32vec3((v - offset) * 16.f + 0.5f)
+                    qvb.reserve(quads.size() * 4);
+                    qib.reserve(quads.size() * 6);
                     
-                    for (size_t i = 0; i < ib.size(); i += 3)
+                    for (auto& q: quads)
                     {
-                        vec3 vn = glm::cross(vb[ib[i+1]].position - vb[ib[i+0]].position, vb[ib[i+2]].position - vb[ib[i+0]].position);
-                        normals[Q(vb[ib[i+0]].position)] += vn;
-                        normals[Q(vb[ib[i+1]].position)] += vn;
-                        normals[Q(vb[ib[i+2]].position)] += vn;
+                        size_t offset = qvb.size();
+                        
+                        vec3 qn = getQuadNormal(vb[q.v[0]].position, vb[q.v[1]].position, vb[q.v[2]].position, vb[q.v[3]].position);
+                        
+                        for (int i = 0; i < 4; ++i)
+                            qvb.push_back(normalLerp(vb[q.v[i]], centers[q.v[i]], qn));
+                        
+                        pushQuadIndices(qib, offset + 0, offset + 1, offset + 2, offset + 3);
                     }
                     
-                    for (size_t i = 0; i < vb.size(); ++i)
-                        vb[i].normal = glm::normalize(normals[Q(vb[i].position)]);
-                    
-                    #undef Q
+                    return make_pair(move(qvb), move(qib));
                 }
- 
+                
                 return make_pair(move(vb), move(ib));
             }
         };
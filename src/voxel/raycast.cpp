@@ -0,0 +1,221 @@
+#include "common.hpp"
+#include "voxel/raycast.hpp"
+
+#include "voxel/grid.hpp"
+#include "voxel/mesher.hpp"
+
+#include <cfloat>
+
+namespace voxel
+{
+    // number of steps that look for the first crossing inside a cube, and bisection steps that refine it
+    const int kRaycastCubeSteps = 4;
+    const int kRaycastRefineSteps = 8;
+    
+    class RaycastSampler
+    {
+    public:
+        explicit RaycastSampler(const Grid& grid)
+        : grid(grid)
+        , chunk(nullptr)
+        , cached(false)
+        {
+        }
+        
+        float get(const glm::i32vec3& p)
+        {
+            glm::i32vec3 cid = p >> int(kChunkSizeLog2);
+            
+            // cube corners are mostly in the same chunk
+            if (!cached || cid != chunkId)
+            {
+                chunkId = cid;
+                chunk = grid.getChunk(cid);
+                cached = true;
+            }
+            
+            if (!chunk)
+                return 0;
+            
+            glm::i32vec3 lp = p - cid * int(kChunkSize);
+            
+            return chunk->getOccupancy(lp.x, lp.y, lp.z);
+        }
+        
+    private:
+        const Grid& grid;
+        
+        glm::i32vec3 chunkId;
+        const Chunk* chunk;
+        bool cached;
+    };
+    
+    static float trilinear(const float (&c)[8], const vec3& t)
+    {
+        float c00 = glm::mix(c[0], c[1], t.x);
+        float c10 = glm::mix(c[2], c[3], t.x);
+        float c01 = glm::mix(c[4], c[5], t.x);
+        float c11 = glm::mix(c[6], c[7], t.x);
+        
+        return glm::mix(glm::mix(c00, c10, t.y), glm::mix(c01, c11, t.y), t.z);
+    }
+    
+    static vec3 trilinearGradient(const float (&c)[8], const vec3& t)
+    {
+        float dx = glm::mix(glm::mix(c[1] - c[0], c[3] - c[2], t.y), glm::mix(c[5] - c[4], c[7] - c[6], t.y), t.z);
+        float dy = glm::mix(glm::mix(c[2] - c[0], c[3] - c[1], t.x), glm::mix(c[6] - c[4], c[7] - c[5], t.x), t.z);
+        float dz = glm::mix(glm::mix(c[4] - c[0], c[5] - c[1], t.x), glm::mix(c[6] - c[2], c[7] - c[3], t.x), t.y);
+        
+        return vec3(dx, dy, dz);
+    }
+    
+    // Finds the first point in [t0, t1] where the trilinear field of the cube reaches the isolevel
+    static optional<float> intersectCube(const float (&c)[8], const glm::i32vec3& cube, const vec3& origin, const vec3& direction, float t0, float t1)
+    {
+        vec3 local = origin - vec3(cube);
+        
+        float prev = t0;
+        
+        if (trilinear(c, local + direction * t0) >= kIsolevel)
+            return t0;
+        
+        for (int i = 1; i <= kRaycastCubeSteps; ++i)
+        {
+            float t = glm::mix(t0, t1, float(i) / kRaycastCubeSteps);
+            
+            if (trilinear(c, local + direction * t) >= kIsolevel)
+            {
+                float lo = prev, hi = t;
+                
+                for (int j = 0; j < kRaycastRefineSteps; ++j)
+                {
+                    float mid = (lo + hi) / 2;
+                    
+                    if (trilinear(c, local + direction * mid) >= kIsolevel)
+                        hi = mid;
+                    else
+                        lo = mid;
+                }
+                
+                return hi;
+            }
+            
+            prev = t;
+        }
+        
+        return optional<float>();
+    }
+    
+    optional<RaycastHit> raycast(const Grid& grid, const vec3& origin, const vec3& direction, float maxDistance)
+    {
+        glm::i32vec3 step;
+        vec3 tDelta;
+        
+        for (int a = 0; a < 3; ++a)
+        {
+            step[a] = (direction[a] > 0) ? 1 : (direction[a] < 0) ? -1 : 0;
+            tDelta[a] = (step[a] == 0) ? FLT_MAX : 1 / fabsf(direction[a]);
+        }
+        
+        // cube is the lower corner sample of the unit cube that contains the ray at t; rays that start on a face go into the cube they look at
+        auto getCube = [&](float t) {
+            vec3 p = origin + direction * t;
+            glm::i32vec3 result = glm::i32vec3(glm::floor(p));
+            
+            for (int a = 0; a < 3; ++a)
+                if (step[a] < 0 && p[a] == float(result[a]))
+                    result[a]--;
+            
+            return result;
+        };
+        
+        auto getNextT = [&](const glm::i32vec3& cube) {
+            vec3 result;
+            
+            for (int a = 0; a < 3; ++a)
+                result[a] = (step[a] == 0) ? FLT_MAX : (float(cube[a] + (step[a] > 0)) - origin[a]) / direction[a];
+            
+            return result;
+        };
+        
+        float t = 0;
+        glm::i32vec3 cube = getCube(t);
+        vec3 tMax = getNextT(cube);
+        
+        while (t <= maxDistance)
+        {
+            bool skipped = false;
+            
+            // a mip block with zero max occupancy contains no surface in the cubes between its samples; skip the largest one
+            for (int level = kChunkSizeLog2; level > 0 && !skipped; --level)
+            {
+                glm::i32vec3 block = cube >> level;
+                glm::i32vec3 begin = block * (1 << level);
+                int last = (1 << level) - 2;
+                
+                glm::i32vec3 offset = cube - begin;
+                
+                if (offset.x > last || offset.y > last || offset.z > last)
+                    continue;
+                
+                if (grid.getMipCell(block, level).max != 0)
+                    continue;
+                
+                int axis = 0;
+                float exit = FLT_MAX;
+                
+                for (int a = 0; a < 3; ++a)
+                    if (step[a] != 0)
+                    {
+                        float ta = (float(begin[a] + (step[a] > 0 ? last + 1 : 0)) - origin[a]) / direction[a];
+                        
+                        if (ta < exit)
+                        {
+                            exit = ta;
+                            axis = a;
+                        }
+                    }
+                
+                // the ray is inside the block at exit on all other axes; clamp away rounding errors
+                t = exit;
+                cube = glm::clamp(getCube(t), begin, begin + last);
+                cube[axis] = (step[axis] > 0) ? begin[axis] + last + 1 : begin[axis] - 1;
+                tMax = getNextT(cube);
+                
+                skipped = true;
+            }
+            
+            if (skipped)
+                continue;
+            
+            // chunks paged in by the mip lookups may move the resident ones, so the sampler only lives for one cube
+            RaycastSampler sampler(grid);
+            
+            float c[8];
+            
+            for (int i = 0; i < 8; ++i)
+                c[i] = sampler.get(cube + glm::i32vec3(i & 1, (i >> 1) & 1, i >> 2));
+            
+            int axis = (tMax.x < tMax.y) ? (tMax.x < tMax.z ? 0 : 2) : (tMax.y < tMax.z ? 1 : 2);
+            float exit = std::min(tMax[axis], maxDistance);
+            
+            if (*max_element(c, c + 8) >= kIsolevel)
+                if (auto hit = intersectCube(c, cube, origin, direction, t, exit))
+                {
+                    vec3 position = origin + direction * *hit;
+                    vec3 gradient = trilinearGradient(c, glm::clamp(position - vec3(cube), 0.f, 1.f));
+                    
+                    // occupancy grows into the solid, so the surface normal points down the gradient
+                    vec3 normal = (glm::length(gradient) > 0) ? -glm::normalize(gradient) : -direction;
+                    
+                    return RaycastHit { position, normal, cube, *hit };
+                }
+            
+            t = tMax[axis];
+            cube[axis] += step[axis];
+            tMax[axis] += tDelta[axis];
+        }
+        
+        return optional<RaycastHit>();
+    }
+}
\ No newline at end of file
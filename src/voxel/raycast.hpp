@@ -0,0 +1,21 @@
+#pragma once
+
+namespace voxel
+{
+    class Grid;
+    
+    struct RaycastHit
+    {
+        vec3 position;
+        vec3 normal;
+        
+        // grid sample at the lower corner of the cube that contains the hit
+        glm::i32vec3 cell;
+        
+        float distance;
+    };
+    
+    // Casts a ray against the occupancy isosurface that the meshers extract; direction must be normalized.
+    // Cubes between grid samples are traversed with a DDA, and empty mip blocks are skipped as a whole
+    optional<RaycastHit> raycast(const Grid& grid, const vec3& origin, const vec3& direction, float maxDistance);
+}
\ No newline at end of file